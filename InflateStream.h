@@ -0,0 +1,449 @@
+#ifndef HTCW_INFLATESTREAM_H
+#define HTCW_INFLATESTREAM_H
+#include <stdlib.h>
+
+// Decompresses gzip, zlib or raw deflate data from another Stream as it is
+// read, a byte at a time, so a compressed body can be handed straight to a
+// LexContext or JsonReader without inflating it into RAM first. Memory is
+// the W byte sliding window plus about 1.3KB, most of it the two 608 byte
+// Huffman tables, and reading a dynamic block header takes about 350 bytes
+// of stack on top. W must be a power of two. The full deflate window is
+// 32KB, but data compressed with a smaller window (zlib windowBits, or
+// gzip -1 on small bodies) inflates with a matching W. A back reference
+// further than W is reported as WindowTooSmall rather than decoded wrong
+template<size_t W = 32768> class InflateStream : public Stream {
+  public:
+    // formats
+    static const uint8_t Auto = 0;
+    static const uint8_t Deflate = 1;
+    static const uint8_t Zlib = 2;
+    static const uint8_t Gzip = 3;
+    // errors
+    static const uint8_t NoError = 0;
+    static const uint8_t UnexpectedEnd = 1;
+    static const uint8_t BadHeader = 2;
+    static const uint8_t BadBlock = 3;
+    static const uint8_t BadCode = 4;
+    static const uint8_t BadDistance = 5;
+    static const uint8_t WindowTooSmall = 6;
+    static const uint8_t BadChecksum = 7;
+
+  private:
+    static const uint8_t StateHeader = 0;
+    static const uint8_t StateBlock = 1;
+    static const uint8_t StateStored = 2;
+    static const uint8_t StateHuffman = 3;
+    static const uint8_t StateCopy = 4;
+    static const uint8_t StateTrailer = 5;
+    static const uint8_t StateDone = 6;
+    static const uint8_t StateError = 7;
+
+    struct Tree {
+      uint16_t counts[16];
+      uint16_t symbols[288];
+    };
+    Stream* _source;
+    uint8_t _format;
+    uint8_t _state;
+    uint8_t _error;
+    bool _final;
+    uint32_t _bits;
+    uint8_t _bitCount;
+    uint32_t _stored;
+    uint16_t _copyLength;
+    uint16_t _copyDistance;
+    uint32_t _position;
+    uint32_t _checksum;
+    uint32_t _adler;
+    int16_t _peeked;
+    Tree _lengths;
+    Tree _distances;
+    uint8_t _window[W];
+
+    bool fail(uint8_t error) {
+      _error = error;
+      _state = StateError;
+      return false;
+    }
+    bool need(uint8_t count) {
+      while (_bitCount < count) {
+        int b = _source->read();
+        if (0 > b)
+          return fail(UnexpectedEnd);
+        _bits |= ((uint32_t)(uint8_t)b) << _bitCount;
+        _bitCount += 8;
+      }
+      return true;
+    }
+    // LSB first, as deflate packs them. count may be up to 24
+    bool bits(uint8_t count, uint32_t& result) {
+      if (!need(count))
+        return false;
+      result = _bits & ((1UL << count) - 1);
+      _bits >>= count;
+      _bitCount -= count;
+      return true;
+    }
+    void align() {
+      _bits >>= _bitCount & 7;
+      _bitCount -= _bitCount & 7;
+    }
+    bool byte(uint8_t& result) {
+      uint32_t b;
+      if (!bits(8, b))
+        return false;
+      result = (uint8_t)b;
+      return true;
+    }
+    static void buildTree(Tree& tree, const uint8_t* lengths, uint16_t count) {
+      uint16_t offsets[16];
+      memset(tree.counts, 0, sizeof(tree.counts));
+      for (uint16_t i = 0; i < count; ++i)
+        ++tree.counts[lengths[i]];
+      tree.counts[0] = 0;
+      uint16_t sum = 0;
+      for (uint8_t i = 0; i < 16; ++i) {
+        offsets[i] = sum;
+        sum += tree.counts[i];
+      }
+      for (uint16_t i = 0; i < count; ++i)
+        if (lengths[i])
+          tree.symbols[offsets[lengths[i]]++] = i;
+    }
+    // walks the canonical code a bit at a time
+    bool decode(const Tree& tree, uint16_t& symbol) {
+      int sum = 0;
+      int code = 0;
+      uint8_t length = 0;
+      do {
+        if (!need(1))
+          return false;
+        code = 2 * code + (int)(_bits & 1);
+        _bits >>= 1;
+        --_bitCount;
+        if (15 < ++length)
+          return fail(BadCode);
+        sum += tree.counts[length];
+        code -= tree.counts[length];
+      } while (0 <= code);
+      symbol = tree.symbols[sum + code];
+      return true;
+    }
+    void buildFixed() {
+      uint8_t lengths[288];
+      memset(lengths, 8, 144);
+      memset(lengths + 144, 9, 112);
+      memset(lengths + 256, 7, 24);
+      memset(lengths + 280, 8, 8);
+      buildTree(_lengths, lengths, 288);
+      memset(lengths, 5, 30);
+      buildTree(_distances, lengths, 30);
+    }
+    bool buildDynamic() {
+      static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+      uint8_t lengths[288 + 32];
+      uint32_t literals, distances, codes, value;
+      if (!bits(5, literals) || !bits(5, distances) || !bits(4, codes))
+        return false;
+      literals += 257;
+      distances += 1;
+      codes += 4;
+      if (286 < literals || 30 < distances)
+        return fail(BadBlock);
+      memset(lengths, 0, 19);
+      for (uint8_t i = 0; i < codes; ++i) {
+        if (!bits(3, value))
+          return false;
+        lengths[order[i]] = (uint8_t)value;
+      }
+      // the code length tree borrows the distance tree until it is built
+      buildTree(_distances, lengths, 19);
+      uint16_t i = 0;
+      while (i < literals + distances) {
+        uint16_t symbol;
+        uint8_t previous = 0;
+        uint32_t repeat;
+        if (!decode(_distances, symbol))
+          return false;
+        if (16 > symbol) {
+          lengths[i++] = (uint8_t)symbol;
+          continue;
+        }
+        if (16 == symbol) {
+          if (!i)
+            return fail(BadBlock);
+          previous = lengths[i - 1];
+          if (!bits(2, repeat))
+            return false;
+          repeat += 3;
+        } else if (17 == symbol) {
+          if (!bits(3, repeat))
+            return false;
+          repeat += 3;
+        } else {
+          if (!bits(7, repeat))
+            return false;
+          repeat += 11;
+        }
+        if (i + repeat > literals + distances)
+          return fail(BadBlock);
+        while (repeat--)
+          lengths[i++] = previous;
+      }
+      if (!lengths[256])
+        return fail(BadBlock);
+      buildTree(_lengths, lengths, (uint16_t)literals);
+      buildTree(_distances, lengths + literals, (uint16_t)distances);
+      return true;
+    }
+    bool readHeader() {
+      uint8_t b0, b1, flags, b;
+      uint32_t skip;
+      if (Deflate == _format)
+        return true;
+      if (!byte(b0) || !byte(b1))
+        return false;
+      if (Auto == _format) {
+        if (0x1F == b0 && 0x8B == b1)
+          _format = Gzip;
+        else if (8 == (b0 & 0x0F) && 0 == ((b0 << 8) | b1) % 31)
+          _format = Zlib;
+        else {
+          // raw deflate. put the two bytes back
+          _format = Deflate;
+          _bits = b0 | ((uint32_t)b1 << 8);
+          _bitCount = 16;
+          return true;
+        }
+      }
+      if (Zlib == _format) {
+        // no preset dictionaries
+        if (8 != (b0 & 0x0F) || ((b0 << 8) | b1) % 31 || (b1 & 0x20))
+          return fail(BadHeader);
+        return true;
+      }
+      if (0x1F != b0 || 0x8B != b1 || !byte(b) || 8 != b || !byte(flags))
+        return fail(BadHeader);
+      // mtime, xfl, os
+      for (uint8_t i = 0; i < 6; ++i)
+        if (!byte(b))
+          return false;
+      if (flags & 4) { // FEXTRA
+        if (!bits(16, skip))
+          return false;
+        while (skip--)
+          if (!byte(b))
+            return false;
+      }
+      for (uint8_t f = 8; f <= 16; f <<= 1) { // FNAME, FCOMMENT
+        if (flags & f) {
+          do {
+            if (!byte(b))
+              return false;
+          } while (b);
+        }
+      }
+      if (flags & 2) // FHCRC
+        return bits(16, skip);
+      return true;
+    }
+    bool readTrailer() {
+      uint32_t lo, hi;
+      align();
+      if (Deflate == _format)
+        return true;
+      if (!bits(16, lo) || !bits(16, hi))
+        return false;
+      if (Gzip == _format) {
+        if ((lo | (hi << 16)) != ~_checksum)
+          return fail(BadChecksum);
+        // ISIZE
+        return bits(16, lo) && bits(16, hi) && ((lo | (hi << 16)) == _position || fail(BadChecksum));
+      }
+      // adler32 is big endian
+      uint32_t adler = ((lo & 0xFF) << 24) | ((lo & 0xFF00) << 8) | ((hi & 0xFF) << 8) | (hi >> 8);
+      return adler == _adler || fail(BadChecksum);
+    }
+    int emit(uint8_t b) {
+      static const uint32_t crc[16] = {
+        0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+        0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+      };
+      _window[_position & (W - 1)] = b;
+      ++_position;
+      if (Gzip == _format) {
+        _checksum ^= b;
+        _checksum = (_checksum >> 4) ^ crc[_checksum & 15];
+        _checksum = (_checksum >> 4) ^ crc[_checksum & 15];
+      } else if (Zlib == _format) {
+        uint32_t a = (_adler & 0xFFFF) + b;
+        if (65521 <= a)
+          a -= 65521;
+        uint32_t s = (_adler >> 16) + a;
+        if (65521 <= s)
+          s -= 65521;
+        _adler = (s << 16) | a;
+      }
+      return b;
+    }
+    bool startCopy(uint16_t symbol) {
+      static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+      static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+      static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+      static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+      uint32_t extra;
+      symbol -= 257;
+      if (29 <= symbol)
+        return fail(BadCode);
+      if (!bits(lengthExtra[symbol], extra))
+        return false;
+      _copyLength = lengthBase[symbol] + (uint16_t)extra;
+      if (!decode(_distances, symbol))
+        return false;
+      if (30 <= symbol)
+        return fail(BadDistance);
+      if (!bits(distanceExtra[symbol], extra))
+        return false;
+      _copyDistance = distanceBase[symbol] + (uint16_t)extra;
+      if (_copyDistance > _position)
+        return fail(BadDistance);
+      if (_copyDistance > W)
+        return fail(WindowTooSmall);
+      _state = StateCopy;
+      return true;
+    }
+    int next() {
+      uint32_t value;
+      uint16_t symbol;
+      for (;;) {
+        switch (_state) {
+          case StateHeader:
+            if (!readHeader())
+              return -1;
+            _state = StateBlock;
+            break;
+          case StateBlock:
+            if (!bits(1, value))
+              return -1;
+            _final = 0 != value;
+            if (!bits(2, value))
+              return -1;
+            if (0 == value) {
+              uint32_t length, inverse;
+              align();
+              if (!bits(16, length) || !bits(16, inverse))
+                return -1;
+              if ((length ^ 0xFFFF) != inverse) {
+                fail(BadBlock);
+                return -1;
+              }
+              _stored = length;
+              _state = StateStored;
+            } else if (1 == value) {
+              buildFixed();
+              _state = StateHuffman;
+            } else if (2 == value) {
+              if (!buildDynamic())
+                return -1;
+              _state = StateHuffman;
+            } else {
+              fail(BadBlock);
+              return -1;
+            }
+            break;
+          case StateStored:
+            if (_stored) {
+              uint8_t b;
+              if (!byte(b))
+                return -1;
+              --_stored;
+              return emit(b);
+            }
+            _state = _final ? StateTrailer : StateBlock;
+            break;
+          case StateHuffman:
+            if (!decode(_lengths, symbol))
+              return -1;
+            if (256 > symbol)
+              return emit((uint8_t)symbol);
+            if (256 == symbol) {
+              _state = _final ? StateTrailer : StateBlock;
+              break;
+            }
+            if (!startCopy(symbol))
+              return -1;
+            break;
+          case StateCopy:
+            if (_copyLength) {
+              --_copyLength;
+              return emit(_window[(_position - _copyDistance) & (W - 1)]);
+            }
+            _state = StateHuffman;
+            break;
+          case StateTrailer:
+            if (!readTrailer())
+              return -1;
+            _state = StateDone;
+            break;
+          default:
+            return -1;
+        }
+      }
+    }
+
+  public:
+    InflateStream() : _source(NULL), _state(StateDone), _error(NoError) {
+      static_assert(0 < W && 0 == (W & (W - 1)), "W must be a power of two");
+    }
+    // Auto tells gzip and zlib apart by their headers and falls back to
+    // raw deflate. pass the format when it is known, since raw data can
+    // happen to start with a valid zlib header
+    bool begin(Stream& source, uint8_t format = Auto) {
+      _source = &source;
+      _format = format;
+      _state = StateHeader;
+      _error = NoError;
+      _final = false;
+      _bits = 0;
+      _bitCount = 0;
+      _stored = 0;
+      _copyLength = 0;
+      _copyDistance = 0;
+      _position = 0;
+      _checksum = 0xFFFFFFFFUL;
+      _adler = 1;
+      _peeked = -1;
+      return true;
+    }
+    // the format, once the header has been read when begun with Auto
+    uint8_t format() const {
+      return _format;
+    }
+    uint8_t error() const {
+      return _error;
+    }
+    // the number of bytes inflated so far
+    uint32_t position() const {
+      return _position;
+    }
+    virtual int available() {
+      return (0 <= _peeked || StateDone > _state) ? 1 : 0;
+    }
+    virtual int read() {
+      if (0 <= _peeked) {
+        int result = _peeked;
+        _peeked = -1;
+        return result;
+      }
+      return next();
+    }
+    virtual int peek() {
+      if (0 > _peeked)
+        _peeked = next();
+      return _peeked;
+    }
+    virtual size_t write(uint8_t) {
+      return 0;
+    }
+};
+#endif
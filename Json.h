@@ -16,6 +16,159 @@ char JSON_ERROR_UNEXPECTED_VALUE_MSG[] = PROGMEM "Unexpected value";
 char JSON_ERROR_UNKNOWN_STATE_MSG[] = PROGMEM "Unknown state";
 #define JSON_ERROR_OUT_OF_MEMORY 7
 char JSON_ERROR_OUT_OF_MEMORY_MSG[] = PROGMEM "Out of memory";
+#define JSON_ERROR_TOO_DEEP 8
+char JSON_ERROR_TOO_DEEP_MSG[] = PROGMEM "Nested too deeply";
+
+// Represents a single node as filled in by JsonReader::readTokens()
+struct JsonToken {
+  // the node type, as returned by nodeType()
+  int8_t nodeType;
+  // the value type for Value and Field nodes, as returned by valueType()
+  int8_t valueType;
+  // the nesting level of the node. a container and its end node share a depth
+  uint16_t depth;
+  // the length of the raw text of the node in the input
+  uint32_t length;
+  // the offset of the node in the input
+  uint64_t position;
+  // numbers and booleans are decoded inline. a number with no fraction or
+  // exponent that fits is in integerValue, exactly, and the rest are in
+  // numericValue
+  union {
+    double numericValue;
+    int64_t integerValue;
+    bool booleanValue;
+  };
+  // true if the number is in integerValue
+  bool isInteger;
+};
+
+// A saved parse position from JsonReader::bookmark(), for restore()
+struct JsonReaderBookmark {
+  // the lexer's position() and location
+  uint64_t position;
+  uint32_t line;
+  uint32_t column;
+  int16_t current;
+  // the reader's state
+  int8_t state;
+  uint16_t depth;
+  uint64_t tokenPosition;
+};
+
+// Default callbacks for JsonReader::parse(), which does nothing with any
+// of them. Derive from it and hide the ones you need. The handler's type is
+// a template argument to parse(), so the calls are direct and can inline.
+// Each callback returns Continue, Stop to end the parse, or Skip, which
+// from onStartObject(), onStartArray() or onKey() skips that value without
+// reporting what is in it. Strings and keys arrive decoded, without their
+// quotes, in the reader's capture buffer, so they only last until the next
+// callback. Hiding one onNumber() hides the other, so bring it back with
+// a using declaration if integers and reals are wanted separately
+class JsonHandler {
+  public:
+    static const int8_t Stop = 0;
+    static const int8_t Continue = 1;
+    static const int8_t Skip = 2;
+    int8_t onStartObject() {
+      return Continue;
+    }
+    int8_t onEndObject() {
+      return Continue;
+    }
+    int8_t onStartArray() {
+      return Continue;
+    }
+    int8_t onEndArray() {
+      return Continue;
+    }
+    int8_t onKey(const char*, size_t) {
+      return Continue;
+    }
+    int8_t onString(const char*, size_t) {
+      return Continue;
+    }
+    int8_t onNumber(double) {
+      return Continue;
+    }
+    int8_t onNumber(int64_t) {
+      return Continue;
+    }
+    int8_t onBoolean(bool) {
+      return Continue;
+    }
+    int8_t onNull() {
+      return Continue;
+    }
+};
+
+// Caches the locations of containers visited while resolving JSON
+// Pointers on a seekable stream, so later lookups into the same document
+// start at the nearest cached ancestor instead of the beginning. Prefixes
+// are keyed by two independent hashes and their length, so a false hit
+// needs a 64-bit collision. Call clear() when the document changes
+template<size_t N> class JsonPointerCache {
+  public:
+    struct Entry {
+      uint32_t hash;
+      uint32_t check;
+      uint16_t length;
+      JsonReaderBookmark bookmark;
+    };
+  private:
+    Entry _entries[N];
+    size_t _count;
+    size_t _next;
+  public:
+    JsonPointerCache() {
+      clear();
+    }
+    void clear() {
+      _count = 0;
+      _next = 0;
+    }
+    size_t count() const {
+      return _count;
+    }
+    // FNV-1a over the raw pointer text
+    static uint32_t hash(const char* pointer, size_t length) {
+      uint32_t result = 2166136261UL;
+      while (length--) {
+        result ^= (uint8_t) * (pointer++);
+        result *= 16777619UL;
+      }
+      return result;
+    }
+    // sdbm over the raw pointer text, to confirm a hash() match
+    static uint32_t check(const char* pointer, size_t length) {
+      uint32_t result = 0;
+      while (length--)
+        result = (uint8_t) * (pointer++) + (result << 6) + (result << 16) - result;
+      return result;
+    }
+    const Entry* find(const char* pointer, size_t length) const {
+      uint32_t h = hash(pointer, length);
+      uint32_t c = check(pointer, length);
+      for (size_t i = 0; i < _count; ++i)
+        if (_entries[i].length == length && _entries[i].hash == h && _entries[i].check == c)
+          return &_entries[i];
+      return NULL;
+    }
+    // returns the entry for the prefix, reusing the oldest one when full
+    Entry* add(const char* pointer, size_t length) {
+      Entry* result = (Entry*)find(pointer, length);
+      if (result)
+        return result;
+      result = &_entries[_next];
+      _next = (_next + 1) % N;
+      if (_count < N)
+        ++_count;
+      result->hash = hash(pointer, length);
+      result->check = check(pointer, length);
+      result->length = (uint16_t)length;
+      return result;
+    }
+};
 
 template<size_t S> class JsonReader {
   public:
@@ -37,19 +190,62 @@ template<size_t S> class JsonReader {
     LexContext<S> _lc;
     int8_t _state;
     uint8_t _lastError;
+    uint16_t _depth;
+    uint64_t _tokenPosition;
 
-    uint8_t fromHexChar(char hex) {
+    static uint8_t fromHexChar(char hex) {
       if (':' > hex && '/' < hex)
         return (uint8_t)(hex - '0');
       if ('G' > hex && '@' < hex)
         return (uint8_t)(hex - '7'); // 'A'-10
       return (uint8_t)(hex - 'W'); // 'a'-10
     }
-    bool isHexChar(char hex) {
+    static bool isHexChar(char hex) {
       return (':' > hex && '/' < hex) ||
              ('G' > hex && '@' < hex) ||
              ('g' > hex && '`' < hex);
     }
+    // up to 4 hex digits of a \u escape, advancing sz past them
+    static uint16_t decodeHex4(const char*& sz) {
+      uint16_t result = 0;
+      for (int i = 0; i < 4 && isHexChar(*sz); ++i)
+        result = result * 16 + fromHexChar(*(sz++));
+      return result;
+    }
+    // the character a backslash escape other than \u stands for
+    static int16_t unescape(int16_t ch) {
+      switch (ch) {
+        case 'r':
+          return '\r';
+        case 'n':
+          return '\n';
+        case 't':
+          return '\t';
+        case 'b':
+          return '\b';
+        case 'f':
+          return '\f';
+        default:
+          return ch;
+      }
+    }
+    // returns the first byte of cp in UTF-8, queueing the rest low first
+    // in pending, or setting it to 0 if there are none
+    static int16_t encodeUtf8(uint32_t cp, uint32_t& pending) {
+      pending = 0;
+      if (0x80 > cp)
+        return (int16_t)cp;
+      if (0x800 > cp) {
+        pending = 0x80 | (cp & 0x3F);
+        return (int16_t)(0xC0 | (cp >> 6));
+      }
+      if (0x10000 > cp) {
+        pending = (0x80 | ((cp >> 6) & 0x3F)) | ((0x80 | (cp & 0x3F)) << 8);
+        return (int16_t)(0xE0 | (cp >> 12));
+      }
+      pending = (0x80 | ((cp >> 12) & 0x3F)) | ((0x80 | ((cp >> 6) & 0x3F)) << 8) | ((0x80 | (cp & 0x3F)) << 16);
+      return (int16_t)(0xF0 | (cp >> 18));
+    }
     // optimization
     void skipObjectPart()
     {
@@ -71,10 +267,11 @@ template<size_t S> class JsonReader {
           case '{':
             ++depth;
             _lc.advance();
-            if(LexContext<S>::EndOfInput==_lc.current())
+            if(LexContext<S>::EndOfInput==_lc.current()) {
               _lastError = JSON_ERROR_UNTERMINATED_OBJECT;
               strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_OBJECT_MSG,S-1);
               _state = Error;
+            }
             break;
           case '\"':
             skipString();
@@ -151,6 +348,501 @@ template<size_t S> class JsonReader {
       }
     }
 
+    // lexes a number at the cursor without going through read(). integers
+    // are accumulated as the digits come in. anything with a fraction or an
+    // exponent (or that doesn't fit in an int64_t) goes through strtod()
+    bool lexNumber(double& real, int64_t& integer, bool& isInteger) {
+      bool negative = false;
+      size_t digits = 0;
+      uint64_t acc = 0;
+      isInteger = true;
+      _lc.clearCapture();
+      if ('-' == _lc.current()) {
+        negative = true;
+        _lc.capture();
+        _lc.advance();
+      }
+      char prev = 0;
+      while (LexContext<S>::EndOfInput != _lc.current()) {
+        char ch = (char)_lc.current();
+        if (isdigit(ch)) {
+          ++digits;
+          if (isInteger) {
+            // INT64_MAX, or one more than that if negative
+            uint64_t limit = (uint64_t)INT64_MAX + (negative ? 1 : 0);
+            uint8_t digit = (uint8_t)(ch - '0');
+            if (acc > (limit - digit) / 10)
+              isInteger = false;
+            else
+              acc = acc * 10 + digit;
+          }
+        } else if ('.' == ch || 'E' == ch || 'e' == ch || '+' == ch || ('-' == ch && ('E' == prev || 'e' == prev)))
+          isInteger = false;
+        else
+          break;
+        prev = ch;
+        if (!_lc.capture()) {
+          _lastError = JSON_ERROR_OUT_OF_MEMORY;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_OUT_OF_MEMORY_MSG,S-1);
+          _state = Error;
+          return false;
+        }
+        _lc.advance();
+      }
+      if (0 == digits) {
+        _lastError = JSON_ERROR_UNEXPECTED_VALUE;
+        strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNEXPECTED_VALUE_MSG,S-1);
+        _state = Error;
+        return false;
+      }
+      if (isInteger) {
+        integer = negative ? (int64_t)(0 - acc) : (int64_t)acc;
+        real = (double)integer;
+      } else {
+        real = strtod(_lc.captureBuffer(), NULL);
+        // clamped, since casting an out of range double is undefined
+        if (real >= 9223372036854775807.0)
+          integer = INT64_MAX;
+        else if (real <= -9223372036854775808.0)
+          integer = INT64_MIN;
+        else
+          integer = (int64_t)real;
+      }
+      _lc.trySkipWhiteSpace();
+      return true;
+    }
+
+    size_t readNumeric(double* reals, int64_t* integers, size_t max) {
+      double real;
+      int64_t integer;
+      bool isInteger;
+      size_t result = 0;
+      if (Initial == _state || Field == _state) {
+        if (!read() || Array != _state)
+          return 0;
+      }
+      if (Array != _state && Value != _state)
+        return 0;
+      bool first = Array == _state;
+      while (result < max) {
+        int16_t ch = _lc.current();
+        if (']' == ch) {
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          _lc.clearCapture();
+          --_depth;
+          _state = EndArray;
+          break;
+        }
+        if (!first) {
+          if (',' != ch)
+            break;
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          ch = _lc.current();
+        }
+        // anything else is left for read() to pick up
+        if ('-' != ch && '.' != ch && !isdigit((char)ch))
+          break;
+        _tokenPosition = _lc.position() - 1;
+        if (!lexNumber(real, integer, isInteger))
+          break;
+        if (reals)
+          reals[result] = real;
+        else
+          integers[result] = integer;
+        ++result;
+        first = false;
+        _state = Value;
+      }
+      return result;
+    }
+
+    // compares the raw (quoted) key against a JSON Pointer reference token
+    static bool keyMatchesToken(const char* key, const char* token, size_t length) {
+      uint32_t pending = 0;
+      if ('\"' == *key)
+        ++key;
+      while (length--) {
+        char ch = *(token++);
+        if ('~' == ch && length) {
+          --length;
+          ch = ('1' == *(token++)) ? '/' : '~';
+        }
+        if ((uint8_t)ch != decodeChar(key, pending))
+          return false;
+      }
+      return -1 == decodeChar(key, pending);
+    }
+    static bool indexMatchesToken(size_t index, const char* token, size_t length) {
+      if (0 == length || (1 < length && '0' == *token))
+        return false;
+      size_t value = 0;
+      while (length--) {
+        if (!isdigit(*token))
+          return false;
+        value = value * 10 + (*(token++) - '0');
+      }
+      return value == index;
+    }
+    // the index of the lowest set bit of a non zero pointer mask. masks are
+    // walked with this, clearing each bit as it's seen, rather than by
+    // shifting them, as a shift by 32 is undefined
+    static uint8_t lowestBit(uint32_t mask) {
+      uint8_t result = 0;
+      while (!(mask & 1)) {
+        mask >>= 1;
+        ++result;
+      }
+      return result;
+    }
+    // returns the pointers in mask whose next reference token names the
+    // current field, or index when in an array
+    uint32_t matchChildren(const char* const* pointers, uint32_t mask, size_t prefix, bool field, size_t index, size_t& length) {
+      uint32_t result = 0;
+      length = 0;
+      for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        size_t i = lowestBit(bits);
+        if ('/' != pointers[i][prefix])
+          continue;
+        const char* token = pointers[i] + prefix + 1;
+        size_t tokenLength = strcspn(token, "/");
+        if (field ? keyMatchesToken(_lc.captureBuffer(), token, tokenLength) : indexMatchesToken(index, token, tokenLength)) {
+          result |= 1UL << i;
+          length = tokenLength;
+        }
+      }
+      return result;
+    }
+    template<typename TCache> void cacheNode(TCache* cache, const char* pointer, size_t prefix) {
+      if (!cache)
+        return;
+      cache->add(pointer, prefix)->bookmark = bookmark();
+    }
+    // the reader is on the node at prefix, which every pointer in mask
+    // shares. reports the pointers that end here and walks the children for
+    // the rest. returns true once all of the pointers have been resolved
+    template<typename TCallback, typename TCache> bool resolveNode(const char* const* pointers, uint32_t mask, size_t prefix, uint32_t all, uint32_t& resolved, TCallback& callback, TCache* cache) {
+      uint32_t deeper = 0;
+      int8_t state = _state;
+      uint16_t depth = _depth;
+      for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        size_t i = lowestBit(bits);
+        if (!pointers[i][prefix]) {
+          resolved |= 1UL << i;
+          callback(i, *this);
+        } else if ('/' == pointers[i][prefix])
+          deeper |= 1UL << i;
+      }
+      if (resolved == all)
+        return true;
+      // the callback may have consumed the node
+      if ((Array != state && Object != state) || state != _state || depth != _depth)
+        return false;
+      if (!deeper) {
+        skipSubtree();
+        return false;
+      }
+      cacheNode(cache, pointers[lowestBit(deeper)], prefix);
+      size_t index = 0;
+      while (deeper && read()) {
+        if (Object == state) {
+          if (Field != _state)
+            break;
+        } else if (EndArray == _state)
+          break;
+        size_t length;
+        uint32_t match = matchChildren(pointers, deeper, prefix, Object == state, index++, length);
+        if (!match) {
+          skipSubtree();
+          continue;
+        }
+        if (Field == _state && !read())
+          break;
+        if (resolveNode(pointers, match, prefix + 1 + length, all, resolved, callback, cache))
+          return true;
+        deeper &= ~match;
+      }
+      // nothing left to find in here
+      if (Error != _state && depth == _depth) {
+        if (Object == state)
+          skipToEndObject();
+        else
+          skipToEndArray();
+      }
+      return false;
+    }
+    template<typename TCallback, typename TCache> uint32_t resolveFrom(const char* const* pointers, size_t count, size_t prefix, TCallback& callback, TCache* cache) {
+      uint32_t resolved = 0;
+      uint32_t all = (32 <= count) ? 0xFFFFFFFFUL : ((1UL << count) - 1);
+      if (!all)
+        return 0;
+      if (Initial == _state && !read())
+        return 0;
+      // on a field the pointers resolve against its value
+      if (Field == _state && !read())
+        return 0;
+      if (Error == _state || EndDocument == _state)
+        return 0;
+      resolveNode(pointers, all, prefix, all, resolved, callback, cache);
+      return resolved;
+    }
+
+    void stage(Print* out, size_t& count, char ch) {
+      if (!out)
+        return;
+      char* buffer = _lc.captureBuffer();
+      buffer[count++] = ch;
+      if (S == count) {
+        out->write((const uint8_t*)buffer, count);
+        count = 0;
+      }
+    }
+    // copies the value at the cursor to out as is, minus any whitespace
+    // outside of strings. values aren't tokenized, just bracket matched, and
+    // the capture buffer is used to batch the writes. container is Array or
+    // Object if read() already consumed the opening bracket. with no out
+    // this is a raw skip
+    bool copyValue(Print* out, int8_t container = Value) {
+      size_t count = 0;
+      int depth = 0;
+      bool quoted = false;
+      int8_t kind = Value;
+      int16_t ch = _lc.current();
+      // a scalar copied from here is left as the current Value, so a
+      // bookmark taken after this must replay it from its start
+      if (Value == container)
+        _tokenPosition = _lc.position() - 1;
+      if (Array == container || Object == container) {
+        stage(out, count, (Array == container) ? '[' : '{');
+        kind = (Array == container) ? EndArray : EndObject;
+        depth = 1;
+      } else if ('[' == ch)
+        kind = EndArray;
+      else if ('{' == ch)
+        kind = EndObject;
+      while (LexContext<S>::EndOfInput != ch) {
+        if (quoted) {
+          stage(out, count, (char)ch);
+          if ('\\' == ch) {
+            if (LexContext<S>::EndOfInput == (ch = _lc.advance()))
+              break;
+            stage(out, count, (char)ch);
+          } else if ('\"' == ch) {
+            quoted = false;
+            if (!depth) {
+              _lc.advance();
+              break;
+            }
+          }
+        } else if (isspace((char)ch)) {
+          if (!depth)
+            break;
+        } else {
+          if ('\"' == ch)
+            quoted = true;
+          else if ('[' == ch || '{' == ch)
+            ++depth;
+          else if (']' == ch || '}' == ch) {
+            if (!depth)
+              break;
+            if (!--depth) {
+              stage(out, count, (char)ch);
+              _lc.advance();
+              break;
+            }
+          } else if (',' == ch && !depth)
+            break;
+          stage(out, count, (char)ch);
+        }
+        ch = _lc.advance();
+      }
+      if (out && count)
+        out->write((const uint8_t*)_lc.captureBuffer(), count);
+      _lc.clearCapture();
+      *_lc.captureBuffer() = 0;
+      if (quoted || depth) {
+        if (quoted) {
+          _lastError = JSON_ERROR_UNTERMINATED_STRING;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_STRING_MSG,S-1);
+        } else if (EndArray == kind) {
+          _lastError = JSON_ERROR_UNTERMINATED_ARRAY;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_ARRAY_MSG,S-1);
+        } else {
+          _lastError = JSON_ERROR_UNTERMINATED_OBJECT;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_OBJECT_MSG,S-1);
+        }
+        _state = Error;
+        return false;
+      }
+      _lc.trySkipWhiteSpace();
+      if (Value != container)
+        --_depth;
+      _state = kind;
+      return true;
+    }
+    // 0 drops the value at the cursor, 1 copies it whole, and 2 copies the
+    // container while projecting its children
+    uint8_t projection(const char* const* pointers, uint32_t mask, size_t prefix) {
+      bool deeper = false;
+      for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        size_t i = lowestBit(bits);
+        if (!pointers[i][prefix])
+          return 1;
+        if ('/' == pointers[i][prefix])
+          deeper = true;
+      }
+      if (deeper && ('[' == _lc.current() || '{' == _lc.current()))
+        return 2;
+      return 0;
+    }
+    bool projectValue(Print& out, const char* const* pointers, uint32_t mask, size_t prefix, uint8_t mode) {
+      if (1 == mode)
+        return copyValue(&out);
+      if (2 != mode)
+        return copyValue(NULL);
+      if (!read())
+        return false;
+      bool object = Object == _state;
+      bool first = true;
+      bool leading = true;
+      size_t index = 0;
+      out.write(object ? '{' : '[');
+      while (Error != _state) {
+        if (object) {
+          if (!read() || Field != _state)
+            break;
+        } else {
+          int16_t ch = _lc.current();
+          if (']' == ch) {
+            _lc.advance();
+            _lc.trySkipWhiteSpace();
+            _lc.clearCapture();
+            --_depth;
+            _state = EndArray;
+            break;
+          }
+          if (!leading) {
+            if (',' != ch) {
+              _lastError = (LexContext<S>::EndOfInput == ch) ? JSON_ERROR_UNTERMINATED_ARRAY : JSON_ERROR_UNEXPECTED_VALUE;
+              strncpy_P(_lc.captureBuffer(),(LexContext<S>::EndOfInput == ch) ? JSON_ERROR_UNTERMINATED_ARRAY_MSG : JSON_ERROR_UNEXPECTED_VALUE_MSG,S-1);
+              _state = Error;
+              break;
+            }
+            _lc.advance();
+            _lc.trySkipWhiteSpace();
+          }
+          leading = false;
+        }
+        size_t length;
+        uint32_t match = matchChildren(pointers, mask, prefix, object, index++, length);
+        uint8_t childMode = match ? projection(pointers, match, prefix + 1 + length) : 0;
+        if (childMode) {
+          if (!first)
+            out.write(',');
+          first = false;
+          if (object) {
+            out.write((const uint8_t*)_lc.captureBuffer(), _lc.captureCount());
+            out.write(':');
+          }
+        }
+        if (!projectValue(out, pointers, match, prefix + 1 + length, childMode))
+          break;
+      }
+      // read() stops at the end of the input as well as on the brace
+      if (object && Error != _state && EndObject != _state) {
+        _lastError = JSON_ERROR_UNTERMINATED_OBJECT;
+        strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_OBJECT_MSG,S-1);
+        _state = Error;
+      }
+      if (Error == _state)
+        return false;
+      out.write(object ? '}' : ']');
+      return true;
+    }
+
+    bool appendCapture(char ch) {
+      size_t count = _lc.captureCount();
+      if (!_lc.setCaptureCount(count + 1))
+        return false;
+      _lc.captureBuffer()[count] = ch;
+      return true;
+    }
+    // appends ch to the capture in its JSON string form
+    bool appendEscaped(char ch) {
+      static const char hex[] = "0123456789abcdef";
+      switch (ch) {
+        case '\"':
+        case '\\':
+          return appendCapture('\\') && appendCapture(ch);
+        case '\n':
+          return appendCapture('\\') && appendCapture('n');
+        case '\r':
+          return appendCapture('\\') && appendCapture('r');
+        case '\t':
+          return appendCapture('\\') && appendCapture('t');
+        default:
+          if (' ' > (uint8_t)ch)
+            return appendCapture('\\') && appendCapture('u') && appendCapture('0') && appendCapture('0') &&
+                   appendCapture(hex[(uint8_t)ch >> 4]) && appendCapture(hex[ch & 15]);
+          return appendCapture(ch);
+      }
+    }
+    // the 4 hex digits of a \u escape from the input, or -1
+    int32_t readHex4() {
+      uint16_t result = 0;
+      for (int i = 0; i < 4; ++i) {
+        int16_t ch = _lc.advance();
+        if (LexContext<S>::EndOfInput == ch || !isHexChar((char)ch))
+          return -1;
+        result = result * 16 + fromHexChar((char)ch);
+      }
+      return result;
+    }
+    // decodes the escape at the cursor to UTF-8 like decodeChar(), leaving
+    // the cursor on its last character. returns the first byte, with the
+    // rest queued low first in pending. a high surrogate that isn't
+    // followed by a low one is U+FFFD, as is a lone low one, or a high
+    // one straight after an unpaired high one
+    int16_t decodeEscape(uint64_t& pending) {
+      uint32_t queue;
+      pending = 0;
+      int16_t ch = _lc.advance();
+      if ('u' != ch)
+        return unescape(ch);
+      int32_t cp = readHex4();
+      if (0 > cp)
+        return LexContext<S>::EndOfInput;
+      if (0xD800 <= cp && 0xDC00 > cp && '\\' == _lc.peek()) {
+        // the escape after it has already been read when it isn't the low
+        // half, so it's queued behind the U+FFFD
+        _lc.advance();
+        ch = _lc.advance();
+        if ('u' != ch) {
+          if (LexContext<S>::EndOfInput == ch)
+            return LexContext<S>::EndOfInput;
+          pending = 0xBDBF | ((uint64_t)(uint8_t)unescape(ch) << 16);
+          return 0xEF;
+        }
+        int32_t low = readHex4();
+        if (0 > low)
+          return LexContext<S>::EndOfInput;
+        if (0xDC00 <= low && 0xE000 > low) {
+          ch = encodeUtf8(0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00), queue);
+          pending = queue;
+          return ch;
+        }
+        ch = encodeUtf8((0xD800 <= low && 0xE000 > low) ? 0xFFFD : low, queue);
+        pending = 0xBDBF | ((uint64_t)(uint8_t)ch << 16) | ((uint64_t)queue << 24);
+        return 0xEF;
+      }
+      if (0xD800 <= cp && 0xE000 > cp)
+        cp = 0xFFFD;
+      ch = encodeUtf8(cp, queue);
+      pending = queue;
+      return ch;
+    }
+
     void skipString()
     {
       if('\"'!=_lc.current()) {
@@ -159,8 +851,10 @@ template<size_t S> class JsonReader {
          _state = Error;
          return;
       }
-      _lc.advance();
-      _lc.trySkipUntil('\"', false);
+      // skip escapes so \" doesn't end the string
+      while (LexContext<S>::EndOfInput != _lc.advance() && '\"' != _lc.current())
+        if ('\\' == _lc.current() && LexContext<S>::EndOfInput == _lc.advance())
+          break;
       if('\"'!=_lc.current()) {
           _lastError = JSON_ERROR_UNTERMINATED_STRING;
           strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_STRING_MSG,S-1);
@@ -171,13 +865,302 @@ template<size_t S> class JsonReader {
       _lc.trySkipWhiteSpace();
     }
 
+    bool parseFail(uint8_t error, const char* message) {
+      _lastError = error;
+      strncpy_P(_lc.captureBuffer(),message,S-1);
+      _state = Error;
+      return false;
+    }
+    // lexes the string at the cursor into the capture, decoded and unquoted
+    bool parseString() {
+      int16_t ch;
+      uint64_t pending = 0;
+      _lc.clearCapture();
+      *_lc.captureBuffer() = 0;
+      while ('\"' != (ch = _lc.advance())) {
+        if ('\\' == ch)
+          ch = decodeEscape(pending);
+        if (LexContext<S>::EndOfInput == ch)
+          return parseFail(JSON_ERROR_UNTERMINATED_STRING, JSON_ERROR_UNTERMINATED_STRING_MSG);
+        if (!appendCapture((char)ch))
+          return parseFail(JSON_ERROR_OUT_OF_MEMORY, JSON_ERROR_OUT_OF_MEMORY_MSG);
+        for (; pending; pending >>= 8)
+          if (!appendCapture((char)(uint8_t)pending))
+            return parseFail(JSON_ERROR_OUT_OF_MEMORY, JSON_ERROR_OUT_OF_MEMORY_MSG);
+      }
+      _lc.advance();
+      _lc.trySkipWhiteSpace();
+      return true;
+    }
+    // the cursor is on the literal's first character
+    bool parseLiteral(const char* literal) {
+      while (*++literal)
+        if (*literal != _lc.advance())
+          return parseFail(JSON_ERROR_UNEXPECTED_VALUE, JSON_ERROR_UNEXPECTED_VALUE_MSG);
+      _lc.advance();
+      _lc.trySkipWhiteSpace();
+      return true;
+    }
+    // the recursive descent behind parse(). the lexing is done here rather
+    // than through read(). containers may not take _depth past limit, which
+    // bounds the stack. returns false on an error or a Stop
+    template<typename THandler> bool parseValue(THandler& handler, uint16_t limit) {
+      int8_t result;
+      double real;
+      int64_t integer;
+      bool isInteger;
+      switch (_lc.current()) {
+        case '{':
+          result = handler.onStartObject();
+          if (JsonHandler::Skip == result)
+            return copyValue(NULL);
+          if (JsonHandler::Stop == result)
+            return false;
+          if (limit <= _depth)
+            return parseFail(JSON_ERROR_TOO_DEEP, JSON_ERROR_TOO_DEEP_MSG);
+          ++_depth;
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          if ('}' != _lc.current()) {
+            for (;;) {
+              if ('\"' != _lc.current())
+                return parseFail(JSON_ERROR_UNTERMINATED_OBJECT, JSON_ERROR_UNTERMINATED_OBJECT_MSG);
+              if (!parseString())
+                return false;
+              if (':' != _lc.current())
+                return parseFail(JSON_ERROR_FIELD_NO_VALUE, JSON_ERROR_FIELD_NO_VALUE_MSG);
+              _lc.advance();
+              _lc.trySkipWhiteSpace();
+              result = handler.onKey(_lc.captureBuffer(), _lc.captureCount());
+              if (JsonHandler::Stop == result)
+                return false;
+              if (!((JsonHandler::Skip == result) ? copyValue(NULL) : parseValue(handler, limit)))
+                return false;
+              if (',' != _lc.current())
+                break;
+              _lc.advance();
+              _lc.trySkipWhiteSpace();
+            }
+            if ('}' != _lc.current())
+              return parseFail(JSON_ERROR_UNTERMINATED_OBJECT, JSON_ERROR_UNTERMINATED_OBJECT_MSG);
+          }
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          --_depth;
+          return JsonHandler::Stop != handler.onEndObject();
+        case '[':
+          result = handler.onStartArray();
+          if (JsonHandler::Skip == result)
+            return copyValue(NULL);
+          if (JsonHandler::Stop == result)
+            return false;
+          if (limit <= _depth)
+            return parseFail(JSON_ERROR_TOO_DEEP, JSON_ERROR_TOO_DEEP_MSG);
+          ++_depth;
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          if (']' != _lc.current()) {
+            for (;;) {
+              if (!parseValue(handler, limit))
+                return false;
+              if (',' != _lc.current())
+                break;
+              _lc.advance();
+              _lc.trySkipWhiteSpace();
+            }
+            if (']' != _lc.current())
+              return parseFail(JSON_ERROR_UNTERMINATED_ARRAY, JSON_ERROR_UNTERMINATED_ARRAY_MSG);
+          }
+          _lc.advance();
+          _lc.trySkipWhiteSpace();
+          --_depth;
+          return JsonHandler::Stop != handler.onEndArray();
+        case '\"':
+          if (!parseString())
+            return false;
+          return JsonHandler::Stop != handler.onString(_lc.captureBuffer(), _lc.captureCount());
+        case 't':
+          return parseLiteral("true") && JsonHandler::Stop != handler.onBoolean(true);
+        case 'f':
+          return parseLiteral("false") && JsonHandler::Stop != handler.onBoolean(false);
+        case 'n':
+          return parseLiteral("null") && JsonHandler::Stop != handler.onNull();
+        case '-':
+        case '.':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+          if (!lexNumber(real, integer, isInteger))
+            return false;
+          return JsonHandler::Stop != (isInteger ? handler.onNumber(integer) : handler.onNumber(real));
+        default:
+          return parseFail(JSON_ERROR_UNEXPECTED_VALUE, JSON_ERROR_UNEXPECTED_VALUE_MSG);
+      }
+    }
+
+    // scans the string at the cursor without capturing it. length is its
+    // raw length, quotes included
+    bool scanString(uint32_t& length) {
+      length = 1;
+      while (LexContext<S>::EndOfInput != _lc.advance()) {
+        ++length;
+        if ('\"' == _lc.current())
+          break;
+        if ('\\' == _lc.current()) {
+          if (LexContext<S>::EndOfInput == _lc.advance())
+            break;
+          ++length;
+        }
+      }
+      if (LexContext<S>::EndOfInput == _lc.current())
+        return parseFail(JSON_ERROR_UNTERMINATED_STRING, JSON_ERROR_UNTERMINATED_STRING_MSG);
+      _lc.advance();
+      _lc.trySkipWhiteSpace();
+      return true;
+    }
+    // lexes the node at the cursor straight into token, without going
+    // back through read(). returns false at the end of the document. an
+    // error is returned as a token. for readTokens()
+    bool lexToken(JsonToken& token) {
+      static const char* const literals[] = {"true", "false", "null"};
+      double real;
+      int64_t integer;
+      bool isInteger;
+      int16_t ch = _lc.current();
+      if (',' == ch) {
+        _lc.advance();
+        _lc.trySkipWhiteSpace();
+        ch = _lc.current();
+        if (LexContext<S>::EndOfInput == ch)
+          parseFail(JSON_ERROR_UNTERMINATED_ARRAY, JSON_ERROR_UNTERMINATED_ARRAY_MSG);
+      }
+      _tokenPosition = _lc.position() - 1;
+      token.position = _tokenPosition;
+      token.depth = _depth;
+      token.length = 1;
+      token.integerValue = 0;
+      token.isInteger = false;
+      if (Error != _state) {
+        switch (ch) {
+          case LexContext<S>::EndOfInput:
+            _state = EndDocument;
+            return false;
+          case '[':
+          case '{':
+            _lc.advance();
+            _lc.trySkipWhiteSpace();
+            _lc.clearCapture();
+            ++_depth;
+            _state = ('[' == ch) ? Array : Object;
+            token.valueType = _state;
+            break;
+          case ']':
+          case '}':
+            _lc.advance();
+            _lc.trySkipWhiteSpace();
+            _lc.clearCapture();
+            token.depth = --_depth;
+            _state = (']' == ch) ? EndArray : EndObject;
+            token.valueType = _state;
+            break;
+          case '\"':
+            // strings aren't captured, so they can be any length
+            _lc.clearCapture();
+            *_lc.captureBuffer() = 0;
+            if (!scanString(token.length))
+              break;
+            _state = Value;
+            token.valueType = String;
+            if (':' == _lc.current()) {
+              _lc.advance();
+              _lc.trySkipWhiteSpace();
+              if (LexContext<S>::EndOfInput == _lc.current()) {
+                parseFail(JSON_ERROR_FIELD_NO_VALUE, JSON_ERROR_FIELD_NO_VALUE_MSG);
+                break;
+              }
+              _state = Field;
+            }
+            break;
+          case 't':
+          case 'f':
+          case 'n': {
+              const char* literal = literals[('t' == ch) ? 0 : ('f' == ch) ? 1 : 2];
+              if (!parseLiteral(literal))
+                break;
+              // captured as read() would, for value() and booleanValue()
+              token.length = (uint32_t)strlen(literal);
+              if (!_lc.setCaptureCount(token.length)) {
+                parseFail(JSON_ERROR_OUT_OF_MEMORY, JSON_ERROR_OUT_OF_MEMORY_MSG);
+                break;
+              }
+              memcpy(_lc.captureBuffer(), literal, token.length);
+              _state = Value;
+              token.valueType = ('n' == ch) ? Null : Boolean;
+              token.booleanValue = 't' == ch;
+            }
+            break;
+          case '-':
+          case '.':
+          case '0':
+          case '1':
+          case '2':
+          case '3':
+          case '4':
+          case '5':
+          case '6':
+          case '7':
+          case '8':
+          case '9':
+            if (!lexNumber(real, integer, isInteger))
+              break;
+            _state = Value;
+            token.valueType = Number;
+            token.length = (uint32_t)_lc.captureCount();
+            token.isInteger = isInteger;
+            if (isInteger)
+              token.integerValue = integer;
+            else
+              token.numericValue = real;
+            break;
+          default:
+            parseFail(JSON_ERROR_UNEXPECTED_VALUE, JSON_ERROR_UNEXPECTED_VALUE_MSG);
+            break;
+        }
+      }
+      token.nodeType = _state;
+      if (Error == _state) {
+        token.valueType = Error;
+        token.length = 0;
+      }
+      return true;
+    }
+
   public:
 
     JsonReader() {
     }
     bool begin(Stream &stream) {
       _state = Initial;
-      _lc.begin(stream);
+      _lastError = JSON_ERROR_NO_ERROR;
+      _depth = 0;
+      _tokenPosition = 0;
+      return _lc.begin(stream);
+    }
+    // starts a new document without clearing the capture buffer, for
+    // reusing a reader on many small documents
+    bool reset(Stream &stream) {
+      _state = Initial;
+      _lastError = JSON_ERROR_NO_ERROR;
+      _depth = 0;
+      _tokenPosition = 0;
+      return _lc.reset(stream);
     }
     int8_t nodeType() {
       return _state;
@@ -185,6 +1168,331 @@ template<size_t S> class JsonReader {
     uint8_t lastError() {
       return _lastError;    
     }
+    // the number of arrays and objects currently open
+    uint16_t depth() {
+      return _depth;
+    }
+    // the offset in the input where the current node starts
+    uint64_t tokenPosition() {
+      return _tokenPosition;
+    }
+    // reads the next node like read(), but when it is a string (a value or
+    // a field name) matches it against trie as it streams in rather than
+    // capturing it. see JsonEnumTrie. returns the index of the matching
+    // string, leaving an empty string in the capture. otherwise returns -1
+    // and leaves the reader as read() would have, capture and all
+    template<typename TTrie> int16_t readEnum(const TTrie& trie) {
+      if (Error == _state || EndDocument == _state)
+        return -1;
+      if (Initial == _state) {
+        _lc.ensureStarted();
+        _state = Value;
+      }
+      _lc.clearCapture();
+      if (',' == _lc.current()) {
+        _lc.advance();
+        _lc.trySkipWhiteSpace();
+      }
+      if ('\"' != _lc.current()) {
+        read();
+        return -1;
+      }
+      _tokenPosition = _lc.position() - 1;
+      uint16_t node = 0;
+      uint16_t length = 0;
+      int16_t ch;
+      int16_t result = -1;
+      uint64_t pending = 0;
+      while ('\"' != (ch = _lc.advance())) {
+        bool escaped = '\\' == ch;
+        if (escaped)
+          ch = decodeEscape(pending);
+        if (LexContext<S>::EndOfInput == ch)
+          break;
+        // the trie holds UTF-8, so an escape is walked a byte at a time
+        uint16_t next = trie.child(node, (char)ch);
+        while (TTrie::None != next && pending) {
+          node = next;
+          ++length;
+          ch = (uint8_t)pending;
+          pending >>= 8;
+          next = trie.child(node, (char)ch);
+        }
+        if (TTrie::None == next) {
+          // not in the set. rebuild what was matched and capture the rest
+          const char* word = trie.word(node);
+          bool ok = appendCapture('\"');
+          for (uint16_t i = 0; ok && i < length; ++i)
+            ok = appendEscaped(word[i]);
+          if (ok)
+            ok = escaped ? appendEscaped((char)ch) : _lc.capture();
+          for (; ok && pending; pending >>= 8)
+            ok = appendEscaped((char)(uint8_t)pending);
+          if (ok)
+            ok = LexContext<S>::EndOfInput != _lc.advance() && _lc.tryReadUntil('\"', '\\', true);
+          if (!ok) {
+            if (LexContext<S>::EndOfInput == _lc.current()) {
+              _lastError = JSON_ERROR_UNTERMINATED_STRING;
+              strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_STRING_MSG,S-1);
+            } else {
+              _lastError = JSON_ERROR_OUT_OF_MEMORY;
+              strncpy_P(_lc.captureBuffer(),JSON_ERROR_OUT_OF_MEMORY_MSG,S-1);
+            }
+            _state = Error;
+            return -1;
+          }
+          node = TTrie::None;
+          break;
+        }
+        node = next;
+        ++length;
+      }
+      if (TTrie::None != node) {
+        if ('\"' != ch) {
+          _lastError = JSON_ERROR_UNTERMINATED_STRING;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNTERMINATED_STRING_MSG,S-1);
+          _state = Error;
+          return -1;
+        }
+        _lc.advance();
+        result = trie.match(node);
+        if (0 > result) {
+          // a prefix of something in the set
+          const char* word = trie.word(node);
+          bool ok = appendCapture('\"');
+          for (uint16_t i = 0; ok && i < length; ++i)
+            ok = appendEscaped(word[i]);
+          if (!ok || !appendCapture('\"')) {
+            _lastError = JSON_ERROR_OUT_OF_MEMORY;
+            strncpy_P(_lc.captureBuffer(),JSON_ERROR_OUT_OF_MEMORY_MSG,S-1);
+            _state = Error;
+            return -1;
+          }
+        } else {
+          appendCapture('\"');
+          appendCapture('\"');
+        }
+      }
+      _lc.trySkipWhiteSpace();
+      _state = Value;
+      if (':' == _lc.current()) {
+        _lc.advance();
+        _lc.trySkipWhiteSpace();
+        if (LexContext<S>::EndOfInput == _lc.current()) {
+          _lastError = JSON_ERROR_FIELD_NO_VALUE;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_FIELD_NO_VALUE_MSG,S-1);
+          _state = Error;
+          return -1;
+        }
+        _state = Field;
+      }
+      return result;
+    }
+    // reads up to max nodes into tokens and returns the number read. an
+    // error is reported as the last token. the nodes are lexed directly,
+    // so this is cheaper per node than read(). strings (values and field
+    // names) are scanned, not captured, so only their position and length
+    // are kept and they aren't limited by S. if the batch ends on a string
+    // value, value() is empty and copySubtree() writes nothing for it
+    size_t readTokens(JsonToken* tokens, size_t max) {
+      size_t result = 0;
+      if (Initial == _state) {
+        _lc.ensureStarted();
+        _lc.trySkipWhiteSpace();
+        _state = Value;
+      }
+      while (result < max && Error != _state && EndDocument != _state && lexToken(tokens[result]))
+        ++result;
+      return result;
+    }
+    // saves the current parse position
+    JsonReaderBookmark bookmark() {
+      JsonReaderBookmark result;
+      result.position = _lc.position();
+      result.line = _lc.line();
+      result.column = _lc.column();
+      result.current = _lc.current();
+      result.state = _state;
+      result.depth = _depth;
+      result.tokenPosition = _tokenPosition;
+      return result;
+    }
+    // returns to a bookmark taken on this document, by seeking stream (one
+    // with seek(position), begun at offset 0) rather than reading up to it.
+    // a field or value isn't kept in the bookmark, so it is read again
+    template<typename TStream> bool restore(TStream& stream, const JsonReaderBookmark& bookmark) {
+      if ((Value == bookmark.state || Field == bookmark.state) && bookmark.tokenPosition < bookmark.position) {
+        if (!_lc.seek(stream, LexContext<S>::BeforeInput, bookmark.line, bookmark.column, bookmark.tokenPosition))
+          return false;
+        _lc.ensureStarted();
+        _state = Value;
+        _depth = bookmark.depth;
+        read();
+        if (bookmark.state != _state || bookmark.position != _lc.position()) {
+          _lastError = JSON_ERROR_UNEXPECTED_VALUE;
+          strncpy_P(_lc.captureBuffer(),JSON_ERROR_UNEXPECTED_VALUE_MSG,S-1);
+          _state = Error;
+          return false;
+        }
+        // the lexer counted lines from the token, so put them back
+        _lc.setLocation(bookmark.line, bookmark.column, bookmark.position);
+        return true;
+      }
+      if (!_lc.seek(stream, bookmark.current, bookmark.line, bookmark.column, bookmark.position))
+        return false;
+      _state = bookmark.state;
+      _depth = bookmark.depth;
+      _tokenPosition = bookmark.tokenPosition;
+      return true;
+    }
+    // resolves a batch of up to 32 JSON Pointers (RFC 6901) against the
+    // current node (the value, if that is a field), or the document if
+    // nothing has been read yet, in a single forward pass. shared prefixes
+    // are only walked once. callback is called as callback(index, reader)
+    // with the reader on each value found. it may read a scalar, or skip or
+    // read through a subtree, but must not leave the reader partway into
+    // one. returns a mask of the pointers that were found. once everything
+    // is found the reader is left where the last one was
+    template<typename TCallback> uint32_t resolvePointers(const char* const* pointers, size_t count, TCallback callback) {
+      return resolveFrom(pointers, count, 0, callback, (JsonPointerCache<1>*)NULL);
+    }
+    // as above, but for a seekable stream (one with seek(position)) that
+    // the reader was begun on at offset 0. the pass starts from the
+    // deepest container in cache that contains every pointer, or from the
+    // start of the document, and the containers it walks are added to cache
+    template<typename TStream, size_t N, typename TCallback> uint32_t resolvePointers(TStream& stream, JsonPointerCache<N>& cache, const char* const* pointers, size_t count, TCallback callback) {
+      if (!count)
+        return 0;
+      // find the longest prefix ending on a reference token that all the
+      // pointers share
+      size_t common = 0;
+      for (size_t i = 0;; ++i) {
+        char ch = pointers[0][i];
+        bool boundary = !ch || '/' == ch;
+        size_t j = 1;
+        for (; j < count; ++j) {
+          char cmp = pointers[j][i];
+          if (boundary ? (cmp && '/' != cmp) : cmp != ch)
+            break;
+        }
+        if (j < count)
+          break;
+        if (boundary)
+          common = i;
+        if (!ch)
+          break;
+      }
+      const typename JsonPointerCache<N>::Entry* entry = NULL;
+      while (!entry) {
+        entry = cache.find(pointers[0], common);
+        if (entry || !common)
+          break;
+        while (common && '/' != pointers[0][--common]);
+      }
+      if (entry) {
+        if (!restore(stream, entry->bookmark))
+          return 0;
+        return resolveFrom(pointers, count, common, callback, &cache);
+      }
+      if (!stream.seek(0))
+        return 0;
+      begin(stream);
+      return resolveFrom(pointers, count, 0, callback, &cache);
+    }
+    // copies the current node and anything under it to out, minified. the
+    // values aren't tokenized, so strings longer than the capture buffer
+    // copy fine. before anything has been read this copies the document
+    bool copySubtree(Print& out) {
+      switch (_state) {
+        case JsonReader<S>::Error:
+        case JsonReader<S>::EndDocument:
+          return false;
+        case JsonReader<S>::Initial:
+          _lc.ensureStarted();
+          _lc.trySkipWhiteSpace();
+          if (LexContext<S>::EndOfInput == _lc.current()) {
+            _state = EndDocument;
+            return false;
+          }
+        // fall through
+        case JsonReader<S>::Field:
+          return copyValue(&out);
+        case JsonReader<S>::Value:
+          out.write((const uint8_t*)_lc.captureBuffer(), _lc.captureCount());
+          return true;
+        case JsonReader<S>::Array:
+        case JsonReader<S>::Object:
+          return copyValue(&out, _state);
+        default:
+          return true;
+      }
+    }
+    // writes the document to out with the whitespace removed
+    bool minify(Print& out) {
+      return copySubtree(out);
+    }
+    // streams the document to out, minified, keeping only the values named
+    // by up to 32 JSON Pointers and the containers that lead to them. kept
+    // values are copied as is, without being tokenized. a pointer of ""
+    // keeps everything, which is the same as minify(). call before reading
+    bool project(Print& out, const char* const* pointers, size_t count) {
+      uint32_t all = (32 <= count) ? 0xFFFFFFFFUL : ((1UL << count) - 1);
+      if (Initial != _state)
+        return false;
+      _lc.ensureStarted();
+      _lc.trySkipWhiteSpace();
+      if (LexContext<S>::EndOfInput == _lc.current()) {
+        _state = EndDocument;
+        return false;
+      }
+      _state = Value;
+      return projectValue(out, pointers, all, 0, projection(pointers, all, 0));
+    }
+    // fast path for homogeneous numeric arrays. call on the array (or the
+    // field that holds it) and it decodes up to max elements straight into
+    // values. it stops early at the end of the array, leaving the reader on
+    // EndArray, or at an element that isn't a number, which read() then
+    // picks up. returns the number of elements decoded
+    size_t readNumbers(double* values, size_t max) {
+      return readNumeric(values, NULL, max);
+    }
+    // as readNumbers() but decodes to integers. values with a fraction or
+    // an exponent are truncated
+    size_t readIntegers(int64_t* values, size_t max) {
+      return readNumeric(NULL, values, max);
+    }
+    // pushes the value at the cursor through handler's callbacks (see
+    // JsonHandler) in one pass, for consumers that want the whole document
+    // rather than a node at a time. call it on a reader that was just
+    // begun, or on a Field for that field's value. returns true once the
+    // value has been parsed, leaving the reader after it as read() would.
+    // returns false on an error, or if the handler stopped, in which case
+    // lastError() is JSON_ERROR_NO_ERROR and the document can't be resumed.
+    // parsing recurses once per level, so containers nested more than
+    // maxDepth deep fail with JSON_ERROR_TOO_DEEP rather than overflowing
+    // the stack
+    template<typename THandler> bool parse(THandler& handler, uint16_t maxDepth = 32) {
+      if (Initial == _state) {
+        _lc.ensureStarted();
+        _lc.trySkipWhiteSpace();
+      } else if (Field != _state)
+        return false;
+      int16_t ch = _lc.current();
+      if (LexContext<S>::EndOfInput == ch) {
+        _state = EndDocument;
+        return false;
+      }
+      _state = Value;
+      _tokenPosition = _lc.position() - 1;
+      uint16_t limit = (0xFFFF - _depth < maxDepth) ? 0xFFFF : _depth + maxDepth;
+      if (!parseValue(handler, limit)) {
+        if (Error != _state)
+          _state = EndDocument;
+        return false;
+      }
+      _state = ('{' == ch) ? EndObject : ('[' == ch) ? EndArray : Value;
+      return true;
+    }
     bool read() {
       int16_t qc;
       int16_t ch;
@@ -199,6 +1507,7 @@ template<size_t S> class JsonReader {
         case JsonReader<S>::Value:
 value_case:
           _lc.clearCapture();
+          _tokenPosition = _lc.position() - 1;
           switch (_lc.current()) {
             case LexContext<S>::EndOfInput:
               _state = EndDocument;
@@ -207,12 +1516,14 @@ value_case:
               _lc.advance();
               _lc.trySkipWhiteSpace();
               _lc.clearCapture();
+              --_depth;
               _state = EndArray;
               return true;
             case '}':
               _lc.advance();
               _lc.trySkipWhiteSpace();
               _lc.clearCapture();
+              --_depth;
               _state = EndObject;
               return true;
             case ',':
@@ -227,11 +1538,13 @@ value_case:
             case '[':
               _lc.advance();
               _lc.trySkipWhiteSpace();
+              ++_depth;
               _state = Array;
               return true;
             case '{':
               _lc.advance();
               _lc.trySkipWhiteSpace();
+              ++_depth;
               _state = Object;
               return true;
             case '-':
@@ -502,6 +1815,7 @@ value_case:
         case JsonReader<S>::Array:// begin array
           skipArrayPart();
           _lc.trySkipWhiteSpace();
+          --_depth;
           _state = EndArray; // end array
           return true;
         case JsonReader<S>::EndArray: // end array
@@ -509,6 +1823,7 @@ value_case:
         case JsonReader<S>::Object:// begin object
           skipObjectPart();
           _lc.trySkipWhiteSpace();
+          --_depth;
           _state = EndObject; // end object
           return true;
         case JsonReader<S>::EndObject: // end object
@@ -524,26 +1839,18 @@ value_case:
       if (Initial==_state || Field == _state) // initial or field
         if (!read())
           return false;
-      if (Array==_state) { // array start
-        if (0 == index) {
-          if (!read())
-            return false;
-        }
-        else {
-          for (int i = 0; i < index; ++i) {
-            if (EndArray == _state) // end array
-              return false;
-            if (!read())
-              return false;
-            if (!skipSubtree())
-              return false;
-          }
-          if ((EndObject==_state || EndArray==_state) && !read())
-            return false;
-        }
-        return true;
+      if (Array!=_state) // array start
+        return false;
+      // onto the first element, then past each one before index
+      if (!read())
+        return false;
+      for (int i = 0; i < index; ++i) {
+        if (EndArray == _state) // end array
+          return false;
+        if (!skipSubtree() || !read())
+          return false;
       }
-      return false;
+      return EndArray != _state;
     }
     bool skipToField(const char* field, bool searchDescendants = false) {
       if (searchDescendants) {
@@ -592,10 +1899,12 @@ value_case:
     }
     void skipToEndObject() {
       skipObjectPart();
+      --_depth;
       _state=EndObject;
     }
     void skipToEndArray() {
       skipArrayPart();
+      --_depth;
       _state=EndArray;
     }
     int8_t valueType() {
@@ -615,6 +1924,127 @@ value_case:
     double numericValue() {
       return strtod(_lc.captureBuffer(),NULL);
     }
+    // decodes the next byte of a raw JSON string, advancing sz past it.
+    // \u escapes, surrogate pairs included, come out as UTF-8, so escaped
+    // and literal text decode the same. the rest of a multibyte character
+    // waits in pending, which must start at 0. returns -1 at the closing
+    // quote or the end of the string
+    static int16_t decodeChar(const char*& sz, uint32_t& pending) {
+      if (pending) {
+        // continuation bytes are never 0, so the queue ends at the first 0
+        int16_t result = (uint8_t)pending;
+        pending >>= 8;
+        return result;
+      }
+      char ch = *sz;
+      if (!ch || '\"' == ch)
+        return -1;
+      ++sz;
+      if ('\\' != ch)
+        return (uint8_t)ch;
+      ch = *sz;
+      if (!ch)
+        return -1;
+      ++sz;
+      if ('u' != ch)
+        return unescape((uint8_t)ch);
+      uint32_t cp = decodeHex4(sz);
+      if (0xD800 <= cp && 0xDC00 > cp) {
+        const char* low = sz;
+        uint32_t cp2 = ('\\' == low[0] && 'u' == low[1]) ? decodeHex4(low += 2) : 0;
+        if (0xDC00 <= cp2 && 0xE000 > cp2) {
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (cp2 - 0xDC00);
+          sz = low;
+        } else
+          cp = 0xFFFD;
+      } else if (0xDC00 <= cp && 0xE000 > cp)
+        cp = 0xFFFD;
+      return encodeUtf8(cp, pending);
+    }
+    // one step of FNV-1a, 32 or 64 bits wide as THash is
+    template<typename THash> static THash fnvStep(THash hash, uint8_t data) {
+      return (THash)((hash ^ data) * (THash)((8 == sizeof(THash)) ? 0x100000001B3ULL : 16777619UL));
+    }
+    template<typename THash> static THash fnvBasis() {
+      return (THash)((8 == sizeof(THash)) ? 0xCBF29CE484222325ULL : 2166136261UL);
+    }
+    // FNV-1a over the decoded UTF-8 of a raw (quoted) JSON string, so
+    // escaped and literal text hash the same. length, if not NULL, gets
+    // the length in characters rather than bytes
+    template<typename THash> static THash hashString(const char* raw, uint16_t* length = NULL) {
+      THash result = fnvBasis<THash>();
+      uint16_t count = 0;
+      uint32_t pending = 0;
+      int16_t ch;
+      if ('\"' == *raw)
+        ++raw;
+      while (-1 != (ch = decodeChar(raw, pending))) {
+        result = fnvStep(result, (uint8_t)ch);
+        if (0x80 != (ch & 0xC0))
+          ++count;
+      }
+      if (length)
+        *length = count;
+      return result;
+    }
+    // FNV-1a over a raw JSON number by value, so 1, 1.0 and 1e0 hash the
+    // same. integral values that fit an int64_t are hashed exactly, from
+    // the digits where there's no exponent. the rest hash as a double
+    template<typename THash> static THash hashNumber(const char* raw) {
+      const char* sz = raw;
+      bool negative = '-' == *sz;
+      bool exact = true;
+      uint64_t acc = 0;
+      if (negative)
+        ++sz;
+      for (; isdigit(*sz); ++sz) {
+        uint64_t limit = (uint64_t)INT64_MAX + (negative ? 1 : 0);
+        uint8_t digit = (uint8_t)(*sz - '0');
+        if (acc > (limit - digit) / 10) {
+          exact = false;
+          break;
+        }
+        acc = acc * 10 + digit;
+      }
+      // a fraction of all zeros doesn't change the value
+      if (exact && '.' == *sz)
+        while ('0' == *(++sz));
+      int64_t integer = 0;
+      uint8_t kind = 'i';
+      const uint8_t* bytes = (const uint8_t*)&integer;
+      double real = 0;
+      if (exact && !*sz)
+        integer = negative ? (int64_t)(0 - acc) : (int64_t)acc;
+      else {
+        real = strtod(raw, NULL);
+        if (real >= -9223372036854775808.0 && real < 9223372036854775808.0 && real == (double)(int64_t)real)
+          integer = (int64_t)real;
+        else {
+          kind = 'd';
+          bytes = (const uint8_t*)&real;
+        }
+      }
+      THash result = fnvStep(fnvBasis<THash>(), kind);
+      for (size_t i = 0; i < 8; ++i)
+        result = fnvStep(result, bytes[i]);
+      return result;
+    }
+    // compares two raw (quoted) JSON strings by their decoded characters
+    static bool stringEquals(const char* lhs, const char* rhs) {
+      if ('\"' == *lhs)
+        ++lhs;
+      if ('\"' == *rhs)
+        ++rhs;
+      uint32_t lhsPending = 0;
+      uint32_t rhsPending = 0;
+      int16_t ch;
+      do {
+        ch = decodeChar(lhs, lhsPending);
+        if (ch != decodeChar(rhs, rhsPending))
+          return false;
+      } while (-1 != ch);
+      return true;
+    }
     void undecorate() {
       char *src = _lc.captureBuffer();
       char *dst = src;
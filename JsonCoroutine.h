@@ -0,0 +1,450 @@
+#ifndef HTCW_JSONCOROUTINE_H
+#define HTCW_JSONCOROUTINE_H
+// host only. needs C++20 coroutines
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#include "Json.h"
+
+// Something suspended on a JsonAsyncSource. poll() is called when bytes
+// arrive and returns true once the handle can be resumed
+class JsonAsyncWaiter {
+  public:
+    std::coroutine_handle<> handle;
+    virtual bool poll() = 0;
+};
+
+// A Stream that is fed bytes with push() rather than pulling them, for
+// use with JsonAsyncReader. It tracks how many structural characters
+// ({}[],:) outside of strings are buffered, which tells the reader when
+// the next read() can finish without running dry. B must hold the
+// longest token plus a little, or push() and the reader can stall each
+// other. Not thread safe: push to it from the thread the parse runs on
+template<size_t B = 4096> class JsonAsyncSource : public Stream {
+    uint8_t _buffer[B];
+    size_t _head;
+    size_t _tail;
+    size_t _structural;
+    uint8_t _pushQuote;
+    uint8_t _readQuote;
+    bool _closed;
+    JsonAsyncWaiter* _waiter;
+
+    // 0 is outside a string, 1 inside, 2 after a backslash
+    static bool structural(uint8_t& quote, uint8_t ch) {
+      if (1 == quote) {
+        if ('\\' == ch)
+          quote = 2;
+        else if ('\"' == ch)
+          quote = 0;
+        return false;
+      }
+      if (2 == quote) {
+        quote = 1;
+        return false;
+      }
+      switch (ch) {
+        case '\"':
+          quote = 1;
+          return false;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ',':
+        case ':':
+          return true;
+        default:
+          return false;
+      }
+    }
+    void wake() {
+      if (_waiter && _waiter->poll()) {
+        JsonAsyncWaiter* waiter = _waiter;
+        _waiter = NULL;
+        waiter->handle.resume();
+      }
+    }
+
+  public:
+    JsonAsyncSource() {
+      begin();
+    }
+    void begin() {
+      _head = 0;
+      _tail = 0;
+      _structural = 0;
+      _pushQuote = 0;
+      _readQuote = 0;
+      _closed = false;
+      _waiter = NULL;
+    }
+    // the room left for push()
+    size_t space() const {
+      return B - (_head - _tail);
+    }
+    // buffers as much of data as fits and resumes the parse if it can now
+    // make progress. returns the number of bytes taken
+    size_t push(const uint8_t* data, size_t length) {
+      size_t room = space();
+      if (length > room)
+        length = room;
+      for (size_t i = 0; i < length; ++i) {
+        uint8_t ch = data[i];
+        _buffer[(_head++) % B] = ch;
+        if (structural(_pushQuote, ch))
+          ++_structural;
+      }
+      wake();
+      return length;
+    }
+    // marks the end of the input
+    void close() {
+      _closed = true;
+      wake();
+    }
+    bool closed() const {
+      return _closed;
+    }
+    // true if at least count structural characters are buffered, or there
+    // is no more input coming
+    bool ready(size_t count) const {
+      return _closed || _structural >= count;
+    }
+    void wait(JsonAsyncWaiter* waiter) {
+      _waiter = waiter;
+    }
+    virtual int available() {
+      return (int)(_head - _tail);
+    }
+    virtual int read() {
+      if (_head == _tail)
+        return -1;
+      uint8_t ch = _buffer[(_tail++) % B];
+      if (structural(_readQuote, ch))
+        --_structural;
+      return ch;
+    }
+    virtual int peek() {
+      if (_head == _tail)
+        return -1;
+      return _buffer[_tail % B];
+    }
+    virtual size_t write(uint8_t) {
+      return 0;
+    }
+};
+
+// A coroutine that yields reader events, from JsonAsyncReader::events().
+// Await next() in another coroutine. It resumes the generator, which reads
+// until the next node, suspending on the source as needed, and returns
+// true with the node type in value(), or false at the end of the document
+// or on an error. The reader is left on the node, so its value() and the
+// like can be checked before the next call
+class JsonEventGenerator {
+  public:
+    struct promise_type {
+      int8_t value;
+      std::coroutine_handle<> consumer;
+      // hands control straight back to whoever awaited next()
+      struct Transfer {
+        bool await_ready() noexcept {
+          return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+          std::coroutine_handle<> consumer = handle.promise().consumer;
+          return consumer ? consumer : std::noop_coroutine();
+        }
+        void await_resume() noexcept {
+        }
+      };
+      JsonEventGenerator get_return_object() {
+        return JsonEventGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() noexcept {
+        return {};
+      }
+      Transfer final_suspend() noexcept {
+        return {};
+      }
+      Transfer yield_value(int8_t node) noexcept {
+        value = node;
+        return {};
+      }
+      void return_void() {
+      }
+      void unhandled_exception() {
+        std::terminate();
+      }
+    };
+    class Next {
+        std::coroutine_handle<promise_type> _handle;
+      public:
+        explicit Next(std::coroutine_handle<promise_type> handle) : _handle(handle) {
+        }
+        bool await_ready() {
+          return !_handle || _handle.done();
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) {
+          _handle.promise().consumer = consumer;
+          return _handle;
+        }
+        bool await_resume() {
+          return _handle && !_handle.done();
+        }
+    };
+  private:
+    std::coroutine_handle<promise_type> _handle;
+  public:
+    explicit JsonEventGenerator(std::coroutine_handle<promise_type> handle) : _handle(handle) {
+    }
+    JsonEventGenerator(JsonEventGenerator&& rhs) noexcept : _handle(rhs._handle) {
+      rhs._handle = nullptr;
+    }
+    JsonEventGenerator(const JsonEventGenerator&) = delete;
+    JsonEventGenerator& operator=(const JsonEventGenerator&) = delete;
+    ~JsonEventGenerator() {
+      if (_handle)
+        _handle.destroy();
+    }
+    Next next() {
+      return Next(_handle);
+    }
+    // the node type from the last successful next()
+    int8_t value() const {
+      return _handle.promise().value;
+    }
+};
+
+// A coroutine front end for JsonReader. read() and the skip functions are
+// awaitables with the same results as their JsonReader counterparts. They
+// finish synchronously when enough input is buffered, and otherwise
+// suspend until push() delivers it, so a parse never blocks a thread
+template<size_t S, size_t B = 4096> class JsonAsyncReader {
+    static const uint8_t ModeRead = 0;
+    static const uint8_t ModeSkipSubtree = 1;
+    static const uint8_t ModeSkipToField = 2;
+    static const uint8_t ModeSkipToIndex = 3;
+    JsonReader<S> _reader;
+    JsonAsyncSource<B>* _source;
+
+  public:
+    class Operation : public JsonAsyncWaiter {
+        static const uint8_t PhaseStart = 0;
+        static const uint8_t PhaseNext = 1;
+        static const uint8_t PhaseCheck = 2;
+        static const uint8_t PhaseValue = 3;
+        static const uint8_t PhaseDrain = 4;
+        static const uint8_t PhaseElement = 5;
+        static const uint8_t PhaseDone = 6;
+        JsonAsyncReader* _owner;
+        uint8_t _mode;
+        uint8_t _phase;
+        uint8_t _after;
+        uint16_t _depth;
+        const char* _field;
+        size_t _index;
+        size_t _count;
+        bool _result;
+
+        bool finish(bool result) {
+          _result = result;
+          _phase = PhaseDone;
+          return true;
+        }
+        // the read() is only started once it is sure to finish. a read can
+        // consume a token, a ':' and whatever follows, so two structural
+        // characters must be buffered past the cursor
+        bool step() {
+          if (!_owner->_source->ready(2))
+            return false;
+          _owner->_reader.read();
+          return true;
+        }
+      public:
+        Operation(JsonAsyncReader* owner, uint8_t mode, const char* field = NULL, size_t index = 0) : _owner(owner), _mode(mode), _phase(PhaseStart), _after(PhaseStart), _depth(0), _field(field), _index(index), _count(0), _result(false) {
+        }
+        virtual bool poll() {
+          JsonReader<S>& reader = _owner->_reader;
+          for (;;) {
+            int8_t state = reader.nodeType();
+            switch (_phase) {
+              case PhaseDone:
+                return true;
+              case PhaseStart:
+                if (ModeRead == _mode) {
+                  if (!_owner->_source->ready(2))
+                    return false;
+                  return finish(reader.read());
+                }
+                if (JsonReader<S>::Error == state || JsonReader<S>::EndDocument == state)
+                  return finish(false);
+                if (JsonReader<S>::Initial == state || (JsonReader<S>::Field == state && ModeSkipToField != _mode)) {
+                  if (!step())
+                    return false;
+                  continue;
+                }
+                if (ModeSkipSubtree == _mode) {
+                  if (JsonReader<S>::Array != state && JsonReader<S>::Object != state)
+                    return finish(true);
+                  _depth = reader.depth();
+                  _after = PhaseDone;
+                  _result = true;
+                  _phase = PhaseDrain;
+                } else if (ModeSkipToField == _mode) {
+                  if (JsonReader<S>::Object == state)
+                    _phase = PhaseNext;
+                  else if (JsonReader<S>::Field == state)
+                    _phase = PhaseCheck;
+                  else
+                    return finish(false);
+                } else {
+                  if (JsonReader<S>::Array != state)
+                    return finish(false);
+                  _phase = PhaseElement;
+                }
+                break;
+              case PhaseNext:
+                if (!step())
+                  return false;
+                if (JsonReader<S>::Field != reader.nodeType())
+                  return finish(false);
+                _phase = PhaseCheck;
+                break;
+              case PhaseCheck:
+                reader.undecorate();
+                if (!strcmp(_field, reader.value()))
+                  return finish(true);
+                _phase = PhaseValue;
+                break;
+              case PhaseValue:
+                // move onto the field's value and skip it
+                if (!step())
+                  return false;
+                state = reader.nodeType();
+                if (JsonReader<S>::Array == state || JsonReader<S>::Object == state) {
+                  _depth = reader.depth();
+                  _after = PhaseNext;
+                  _phase = PhaseDrain;
+                } else if (JsonReader<S>::Value == state)
+                  _phase = PhaseNext;
+                else
+                  return finish(false);
+                break;
+              case PhaseElement:
+                if (!step())
+                  return false;
+                state = reader.nodeType();
+                if (JsonReader<S>::Value != state && JsonReader<S>::Array != state && JsonReader<S>::Object != state)
+                  return finish(false);
+                if (_count++ == _index)
+                  return finish(true);
+                if (JsonReader<S>::Array == state || JsonReader<S>::Object == state) {
+                  _depth = reader.depth();
+                  _after = PhaseElement;
+                  _phase = PhaseDrain;
+                }
+                break;
+              case PhaseDrain:
+                // read until the container opened at _depth is closed
+                while (reader.depth() >= _depth) {
+                  if (JsonReader<S>::Error == reader.nodeType() || JsonReader<S>::EndDocument == reader.nodeType())
+                    return finish(false);
+                  if (!step())
+                    return false;
+                }
+                if (PhaseDone == _after)
+                  return finish(_result);
+                _phase = _after;
+                break;
+            }
+          }
+        }
+        bool await_ready() {
+          return poll();
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+          this->handle = handle;
+          _owner->_source->wait(this);
+        }
+        bool await_resume() {
+          return _result;
+        }
+    };
+
+    bool begin(JsonAsyncSource<B>& source) {
+      _source = &source;
+      return _reader.begin(source);
+    }
+    // the underlying reader, for nodeType(), value() and the like. don't
+    // call its read() or skip functions directly
+    JsonReader<S>& reader() {
+      return _reader;
+    }
+    Operation read() {
+      return Operation(this, ModeRead);
+    }
+    Operation skipSubtree() {
+      return Operation(this, ModeSkipSubtree);
+    }
+    Operation skipToField(const char* field) {
+      return Operation(this, ModeSkipToField, field);
+    }
+    Operation skipToIndex(size_t index) {
+      return Operation(this, ModeSkipToIndex, NULL, index);
+    }
+    // the rest of the document as a stream of node types. see
+    // JsonEventGenerator
+    JsonEventGenerator events() {
+      // not while (co_await read()), which GCC 12 miscompiles here
+      for (;;) {
+        bool more = co_await read();
+        if (!more)
+          break;
+        co_yield _reader.nodeType();
+      }
+    }
+};
+
+// A minimal coroutine type for running a parse. It starts right away and
+// keeps its frame until the JsonTask is destroyed, so done() can be checked
+class JsonTask {
+  public:
+    struct promise_type {
+      JsonTask get_return_object() {
+        return JsonTask(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_never initial_suspend() noexcept {
+        return {};
+      }
+      std::suspend_always final_suspend() noexcept {
+        return {};
+      }
+      void return_void() {
+      }
+      void unhandled_exception() {
+        std::terminate();
+      }
+    };
+  private:
+    std::coroutine_handle<promise_type> _handle;
+  public:
+    explicit JsonTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {
+    }
+    JsonTask(JsonTask&& rhs) noexcept : _handle(rhs._handle) {
+      rhs._handle = nullptr;
+    }
+    JsonTask(const JsonTask&) = delete;
+    JsonTask& operator=(const JsonTask&) = delete;
+    ~JsonTask() {
+      if (_handle)
+        _handle.destroy();
+    }
+    bool done() const {
+      return !_handle || _handle.done();
+    }
+};
+#endif
+#endif
+#endif
@@ -0,0 +1,92 @@
+#ifndef HTCW_JSONENUMTRIE_H
+#define HTCW_JSONENUMTRIE_H
+// needs C++14 constexpr
+#if __cplusplus >= 201402L
+#include "Json.h"
+
+// the number of trie nodes needed for words, for sizing a JsonEnumTrie
+template<size_t N> constexpr size_t jsonEnumTrieSize(const char* const (&words)[N]) {
+  size_t result = 1;
+  for (size_t w = 0; w < N; ++w) {
+    for (size_t length = 1; words[w][length - 1]; ++length) {
+      // count each prefix once, the first time it shows up
+      bool seen = false;
+      for (size_t v = 0; v < w && !seen; ++v) {
+        size_t i = 0;
+        while (i < length && words[v][i] == words[w][i])
+          ++i;
+        seen = i == length;
+      }
+      if (!seen)
+        ++result;
+    }
+  }
+  return result;
+}
+
+// A trie over a closed set of strings, built at compile time, for
+// JsonReader::readEnum(). M is the node count from jsonEnumTrieSize():
+//
+//   static constexpr const char* verbs[] = {"get", "set", "reset"};
+//   static constexpr JsonEnumTrie<jsonEnumTrieSize(verbs)> verbTrie(verbs);
+//
+// The words must outlive the trie, which a constexpr array does
+template<size_t M> class JsonEnumTrie {
+  public:
+    static const uint16_t None = 0xFFFF;
+
+  private:
+    char _chars[M];
+    uint16_t _child[M];
+    uint16_t _next[M];
+    int16_t _match[M];
+    uint16_t _word[M];
+    const char* const* _words;
+
+  public:
+    template<size_t N> constexpr JsonEnumTrie(const char* const (&words)[N]) : _chars(), _child(), _next(), _match(), _word(), _words(words) {
+      uint16_t count = 1;
+      _child[0] = None;
+      _next[0] = None;
+      _match[0] = -1;
+      for (size_t w = 0; w < N; ++w) {
+        uint16_t node = 0;
+        for (const char* sz = words[w]; *sz; ++sz) {
+          uint16_t child = _child[node];
+          while (None != child && _chars[child] != *sz)
+            child = _next[child];
+          if (None == child) {
+            // a compile error here means M is too small
+            child = count++;
+            _chars[child] = *sz;
+            _child[child] = None;
+            _next[child] = _child[node];
+            _match[child] = -1;
+            _word[child] = (uint16_t)w;
+            _child[node] = child;
+          }
+          node = child;
+        }
+        if (0 > _match[node])
+          _match[node] = (int16_t)w;
+      }
+    }
+    // the node reached from node by ch, or None
+    uint16_t child(uint16_t node, char ch) const {
+      uint16_t result = _child[node];
+      while (None != result && _chars[result] != ch)
+        result = _next[result];
+      return result;
+    }
+    // the index of the word that ends at node, or -1
+    int16_t match(uint16_t node) const {
+      return _match[node];
+    }
+    // a word that passes through node. its first n characters spell the
+    // path to a node n deep
+    const char* word(uint16_t node) const {
+      return _words[_word[node]];
+    }
+};
+#endif
+#endif
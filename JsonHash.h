@@ -0,0 +1,144 @@
+#ifndef HTCW_JSONHASH_H
+#define HTCW_JSONHASH_H
+#include "Json.h"
+
+// Computes a 64-bit hash of a document's canonical form as it is read.
+// Whitespace doesn't count, strings are hashed as UTF-8 after their
+// escapes are decoded, so "\u00e9" hashes the same as a literal e-acute,
+// and numbers by value, so 1, 1.0 and 1e0 hash the same while integers
+// too big for a double still hash apart. With Unordered, an object hashes
+// the same whatever order its fields are in.
+// Either call read() here instead of on the reader, or call update()
+// after each of your own reads, so it can share a pass with a validator
+// or a read() loop. Don't skip while hashing, as the skipped nodes are
+// never seen. D is the deepest nesting that can be hashed
+template<size_t D = 8> class JsonHash {
+  public:
+    static const uint8_t Ordered = 0;
+    static const uint8_t Unordered = 1;
+
+  private:
+    struct Frame {
+      uint64_t hash;
+      uint64_t key;
+      uint32_t count;
+      bool object;
+    };
+    Frame _frames[D];
+    int16_t _top;
+    uint8_t _options;
+    bool _overflow;
+    uint64_t _last;
+    uint64_t _hash;
+
+    // the murmur3 finalizer
+    static uint64_t mix(uint64_t value) {
+      value ^= value >> 33;
+      value *= 0xFF51AFD7ED558CCDULL;
+      value ^= value >> 33;
+      value *= 0xC4CEB9FE1A85EC53ULL;
+      value ^= value >> 33;
+      return value;
+    }
+    template<size_t S> static uint64_t hashScalar(JsonReader<S>& reader) {
+      switch (reader.valueType()) {
+        case JsonReader<S>::String:
+          return mix(JsonReader<1>::hashString<uint64_t>(reader.value()) ^ 's');
+        case JsonReader<S>::Number:
+          return mix(JsonReader<1>::hashNumber<uint64_t>(reader.value()) ^ 'n');
+        case JsonReader<S>::Boolean:
+          return mix(reader.booleanValue() ? 't' : 'f');
+        default:
+          return mix('z');
+      }
+    }
+    // folds a finished value into its container, or makes it the result
+    void complete(uint64_t value) {
+      _last = value;
+      if (0 > _top) {
+        _hash = value;
+        return;
+      }
+      Frame& frame = _frames[_top];
+      ++frame.count;
+      if (frame.object) {
+        uint64_t member = mix(frame.key ^ (value * 0x9E3779B97F4A7C15ULL));
+        if (Unordered & _options)
+          frame.hash += member;
+        else
+          frame.hash = mix(frame.hash ^ member) * 0x9E3779B97F4A7C15ULL;
+      } else
+        frame.hash = mix(frame.hash ^ value) * 0x9E3779B97F4A7C15ULL;
+    }
+
+  public:
+    JsonHash() {
+      begin();
+    }
+    bool begin(uint8_t options = Ordered) {
+      _top = -1;
+      _options = options;
+      _overflow = false;
+      _last = 0;
+      _hash = 0;
+      return true;
+    }
+    // the hash of a raw (quoted) JSON string, as field names are keyed
+    static uint64_t hashString(const char* raw) {
+      return JsonReader<1>::hashString<uint64_t>(raw);
+    }
+    // the hash of the document, once it has all been read
+    uint64_t hash() const {
+      return _hash;
+    }
+    // the hash of the last value completed. after an EndArray or EndObject
+    // this is the hash of that whole subtree
+    uint64_t lastHash() const {
+      return _last;
+    }
+    // true if the document nested deeper than D, which makes the hashes
+    // meaningless
+    bool overflow() const {
+      return _overflow;
+    }
+    // reads the next node and folds it into the hash. returns what the
+    // reader's read() does
+    template<size_t S> bool read(JsonReader<S>& reader) {
+      if (!reader.read())
+        return false;
+      update(reader);
+      return true;
+    }
+    // folds the node the reader is on into the hash. call once per node,
+    // after each read() that returned true
+    template<size_t S> void update(JsonReader<S>& reader) {
+      switch (reader.nodeType()) {
+        case JsonReader<S>::Value:
+          complete(hashScalar(reader));
+          break;
+        case JsonReader<S>::Field:
+          if (0 <= _top)
+            _frames[_top].key = hashString(reader.value());
+          break;
+        case JsonReader<S>::Array:
+        case JsonReader<S>::Object:
+          if (D <= (size_t)(_top + 1)) {
+            _overflow = true;
+            break;
+          }
+          ++_top;
+          _frames[_top].object = JsonReader<S>::Object == reader.nodeType();
+          _frames[_top].hash = _frames[_top].object ? 0x6F : 0x61;
+          _frames[_top].count = 0;
+          break;
+        case JsonReader<S>::EndArray:
+        case JsonReader<S>::EndObject:
+          if (0 <= _top) {
+            Frame& frame = _frames[_top--];
+            complete(mix(frame.hash ^ ((uint64_t)frame.count << 1) ^ (frame.object ? 1 : 0)));
+          }
+          break;
+      }
+    }
+};
+#endif
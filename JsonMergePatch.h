@@ -0,0 +1,280 @@
+#ifndef HTCW_JSONMERGEPATCH_H
+#define HTCW_JSONMERGEPATCH_H
+#include "Json.h"
+
+// Applies a JSON Merge Patch (RFC 7386) to a document as it streams from
+// one reader to a Print, without building either document in memory. The
+// patch is loaded first into a tree of up to N keys, with its keys and
+// replacement values kept raw in a P byte pool. The target is then read
+// once: fields the patch doesn't name are copied through untouched, named
+// ones are replaced, merged or dropped, and new ones are added at the end
+// of their object. Memory depends on the patch, not the document
+template<size_t N = 32, size_t P = 512> class JsonMergePatch {
+  public:
+    static const uint8_t Delete = 0;
+    static const uint8_t Replace = 1;
+    static const uint8_t Merge = 2;
+    // errors
+    static const uint8_t NoError = 0;
+    static const uint8_t BadDocument = 1;
+    static const uint8_t TooBig = 2;
+    static const uint16_t None = 0xFFFF;
+
+    struct Node {
+      // offsets into the pool. keys are stored quoted and terminated
+      uint16_t key;
+      uint16_t value;
+      uint16_t valueLength;
+      uint16_t firstChild;
+      uint16_t next;
+      uint8_t kind;
+      bool seen;
+    };
+
+  private:
+    // writes into the pool
+    class PoolPrint : public Print {
+        JsonMergePatch* _owner;
+      public:
+        PoolPrint(JsonMergePatch* owner) : _owner(owner) {
+        }
+        virtual size_t write(uint8_t ch) {
+          if (P <= _owner->_poolCount) {
+            _owner->_error = TooBig;
+            return 0;
+          }
+          _owner->_pool[_owner->_poolCount++] = (char)ch;
+          return 1;
+        }
+    };
+    // for skipping values without the capture size limit
+    class NullPrint : public Print {
+      public:
+        virtual size_t write(uint8_t) {
+          return 1;
+        }
+        virtual size_t write(const uint8_t*, size_t size) {
+          return size;
+        }
+    };
+    Node _nodes[N];
+    char _pool[P];
+    uint16_t _nodeCount;
+    uint16_t _poolCount;
+    uint8_t _error;
+
+    // keeps the first error, so a TooBig isn't reported as the
+    // BadDocument it causes on the way back out
+    bool fail(uint8_t error) {
+      if (NoError == _error)
+        _error = error;
+      return false;
+    }
+    uint16_t addNode(uint16_t parent) {
+      if (N <= _nodeCount) {
+        fail(TooBig);
+        return None;
+      }
+      Node& node = _nodes[_nodeCount];
+      node.key = None;
+      node.value = 0;
+      node.valueLength = 0;
+      node.firstChild = None;
+      node.next = None;
+      node.kind = Merge;
+      if (None != parent) {
+        // keep the patch's order for the fields it adds
+        uint16_t* link = &_nodes[parent].firstChild;
+        while (None != *link)
+          link = &_nodes[*link].next;
+        *link = _nodeCount;
+      }
+      return _nodeCount++;
+    }
+    bool addString(const char* sz, size_t length) {
+      if (P < _poolCount + length)
+        return fail(TooBig);
+      memcpy(_pool + _poolCount, sz, length);
+      _poolCount += (uint16_t)length;
+      return true;
+    }
+    template<size_t S> bool loadValue(JsonReader<S>& reader, uint16_t index) {
+      Node& node = _nodes[index];
+      switch (reader.nodeType()) {
+        case JsonReader<S>::Object:
+          node.kind = Merge;
+          return loadObject(reader, index);
+        case JsonReader<S>::Value:
+          if (JsonReader<S>::Null == reader.valueType()) {
+            node.kind = Delete;
+            return true;
+          }
+        // fall through
+        case JsonReader<S>::Array: {
+            PoolPrint pool(this);
+            node.kind = Replace;
+            node.value = _poolCount;
+            if (!reader.copySubtree(pool))
+              return fail(BadDocument);
+            node.valueLength = _poolCount - node.value;
+            return NoError == _error;
+          }
+        default:
+          return fail(BadDocument);
+      }
+    }
+    template<size_t S> bool loadObject(JsonReader<S>& reader, uint16_t parent) {
+      while (reader.read() && JsonReader<S>::Field == reader.nodeType()) {
+        // a repeated key is loaded over the earlier one, so the last wins.
+        // the nodes and pool space the earlier value used are left unused
+        uint16_t index = _nodes[parent].firstChild;
+        while (None != index && !JsonReader<S>::stringEquals(reader.value(), _pool + _nodes[index].key))
+          index = _nodes[index].next;
+        if (None != index)
+          _nodes[index].firstChild = None;
+        else {
+          index = addNode(parent);
+          if (None == index)
+            return false;
+          _nodes[index].key = _poolCount;
+          if (!addString(reader.value(), strlen(reader.value()) + 1))
+            return false;
+        }
+        if (!reader.read() || !loadValue(reader, index))
+          return fail(BadDocument);
+      }
+      if (JsonReader<S>::EndObject != reader.nodeType())
+        return fail(BadDocument);
+      return true;
+    }
+    void writeKey(Print& out, const Node& node) {
+      out.write((const uint8_t*)_pool + node.key, strlen(_pool + node.key));
+      out.write(':');
+    }
+    // writes a Merge node as an object, leaving out its deletions, which
+    // is the patch applied to an empty object
+    void writeObject(Print& out, uint16_t index) {
+      bool first = true;
+      out.write('{');
+      for (uint16_t i = _nodes[index].firstChild; None != i; i = _nodes[i].next) {
+        if (Delete == _nodes[i].kind)
+          continue;
+        if (!first)
+          out.write(',');
+        first = false;
+        writeKey(out, _nodes[i]);
+        writeValue(out, i);
+      }
+      out.write('}');
+    }
+    void writeValue(Print& out, uint16_t index) {
+      if (Merge == _nodes[index].kind)
+        writeObject(out, index);
+      else if (Replace == _nodes[index].kind)
+        out.write((const uint8_t*)_pool + _nodes[index].value, _nodes[index].valueLength);
+      else
+        out.write((const uint8_t*)"null", 4);
+    }
+    // the target reader is on an object that index is to be merged into
+    template<size_t S> bool mergeObject(JsonReader<S>& target, Print& out, uint16_t index) {
+      NullPrint skip;
+      bool first = true;
+      out.write('{');
+      while (target.read() && JsonReader<S>::Field == target.nodeType()) {
+        uint16_t child = _nodes[index].firstChild;
+        while (None != child && !JsonReader<S>::stringEquals(target.value(), _pool + _nodes[child].key))
+          child = _nodes[child].next;
+        if (None == child || Delete != _nodes[child].kind) {
+          if (!first)
+            out.write(',');
+          first = false;
+          out.write((const uint8_t*)target.value(), strlen(target.value()));
+          out.write(':');
+        }
+        if (None == child) {
+          if (!target.copySubtree(out))
+            return fail(BadDocument);
+          continue;
+        }
+        Node& node = _nodes[child];
+        node.seen = true;
+        if (Merge != node.kind) {
+          if (!target.copySubtree(skip))
+            return fail(BadDocument);
+          if (Replace == node.kind)
+            writeValue(out, child);
+          continue;
+        }
+        if (!target.read())
+          return fail(BadDocument);
+        if (JsonReader<S>::Object == target.nodeType()) {
+          if (!mergeObject(target, out, child))
+            return false;
+        } else {
+          // merging into something that isn't an object replaces it
+          if (!target.copySubtree(skip))
+            return fail(BadDocument);
+          writeObject(out, child);
+        }
+      }
+      if (JsonReader<S>::EndObject != target.nodeType())
+        return fail(BadDocument);
+      for (uint16_t i = _nodes[index].firstChild; None != i; i = _nodes[i].next) {
+        if (_nodes[i].seen || Delete == _nodes[i].kind)
+          continue;
+        if (!first)
+          out.write(',');
+        first = false;
+        writeKey(out, _nodes[i]);
+        writeValue(out, i);
+      }
+      out.write('}');
+      return true;
+    }
+
+  public:
+    JsonMergePatch() {
+      clear();
+    }
+    void clear() {
+      _nodeCount = 0;
+      _poolCount = 0;
+      _error = NoError;
+    }
+    uint8_t error() const {
+      return _error;
+    }
+    // loads the patch document from a reader that has just been begun.
+    // keys and scalar values are limited by its capture size
+    template<size_t S> bool load(JsonReader<S>& patch) {
+      clear();
+      uint16_t root = addNode(None);
+      if (!patch.read())
+        return fail(BadDocument);
+      return loadValue(patch, root);
+    }
+    // streams target, which has just been begun, to out with the patch
+    // applied. the result is minified. on an error, out holds a partial
+    // document
+    template<size_t S> bool apply(JsonReader<S>& target, Print& out) {
+      NullPrint skip;
+      if (NoError != _error || !_nodeCount)
+        return false;
+      for (uint16_t i = 0; i < _nodeCount; ++i)
+        _nodes[i].seen = false;
+      // a patch that isn't an object replaces the whole document
+      if (Merge != _nodes[0].kind) {
+        writeValue(out, 0);
+        return true;
+      }
+      if (!target.read())
+        return fail(BadDocument);
+      if (JsonReader<S>::Object == target.nodeType())
+        return mergeObject(target, out, 0);
+      if (!target.copySubtree(skip))
+        return fail(BadDocument);
+      writeObject(out, 0);
+      return true;
+    }
+};
+#endif
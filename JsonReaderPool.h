@@ -0,0 +1,92 @@
+#ifndef HTCW_JSONREADERPOOL_H
+#define HTCW_JSONREADERPOOL_H
+// needs std::atomic, so not on the smaller boards
+#if defined(__has_include)
+#if __has_include(<atomic>)
+#include <atomic>
+#include "Json.h"
+
+struct JsonReaderPoolStats {
+  // successful checkouts
+  uint32_t checkouts;
+  // checkins
+  uint32_t checkins;
+  // checkouts that found the pool empty
+  uint32_t misses;
+  // the most readers out at once
+  uint32_t peak;
+};
+
+// A fixed set of N (up to 32) prebuilt readers that threads check out and
+// back in, so readers aren't built per message or kept per thread. The
+// free list is a bitmask updated with compare and swap, so it's lock free
+// and never blocks. checkout() returns NULL when every reader is out
+template<size_t S, size_t N = 8> class JsonReaderPool {
+    JsonReader<S> _readers[N];
+    std::atomic<uint32_t> _free;
+    std::atomic<uint32_t> _checkouts;
+    std::atomic<uint32_t> _checkins;
+    std::atomic<uint32_t> _misses;
+    std::atomic<uint32_t> _peak;
+
+    static uint8_t count(uint32_t mask) {
+      uint8_t result = 0;
+      for (; mask; mask &= mask - 1)
+        ++result;
+      return result;
+    }
+
+  public:
+    JsonReaderPool() : _free((32 <= N) ? 0xFFFFFFFFUL : ((1UL << N) - 1)), _checkouts(0), _checkins(0), _misses(0), _peak(0) {
+      static_assert(0 < N && 32 >= N, "a pool holds 1 to 32 readers");
+    }
+    JsonReader<S>* checkout() {
+      uint32_t mask = _free.load(std::memory_order_acquire);
+      for (;;) {
+        if (!mask) {
+          _misses.fetch_add(1, std::memory_order_relaxed);
+          return NULL;
+        }
+        uint32_t bit = mask & (~mask + 1); // lowest free reader
+        if (_free.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acq_rel, std::memory_order_acquire)) {
+          _checkouts.fetch_add(1, std::memory_order_relaxed);
+          uint32_t out = (uint32_t)N - count(mask & ~bit);
+          uint32_t peak = _peak.load(std::memory_order_relaxed);
+          while (out > peak && !_peak.compare_exchange_weak(peak, out, std::memory_order_relaxed));
+          uint8_t index = 0;
+          while (!(bit & (1UL << index)))
+            ++index;
+          return &_readers[index];
+        }
+      }
+    }
+    // checks out a reader already reset() onto stream
+    JsonReader<S>* checkout(Stream& stream) {
+      JsonReader<S>* result = checkout();
+      if (result)
+        result->reset(stream);
+      return result;
+    }
+    bool checkin(JsonReader<S>* reader) {
+      if (reader < _readers || reader >= _readers + N)
+        return false;
+      _free.fetch_or(1UL << (reader - _readers), std::memory_order_release);
+      _checkins.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    // the number of readers currently checked in
+    size_t available() const {
+      return count(_free.load(std::memory_order_relaxed));
+    }
+    JsonReaderPoolStats stats() const {
+      JsonReaderPoolStats result;
+      result.checkouts = _checkouts.load(std::memory_order_relaxed);
+      result.checkins = _checkins.load(std::memory_order_relaxed);
+      result.misses = _misses.load(std::memory_order_relaxed);
+      result.peak = _peak.load(std::memory_order_relaxed);
+      return result;
+    }
+};
+#endif
+#endif
+#endif
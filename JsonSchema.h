@@ -0,0 +1,520 @@
+#ifndef HTCW_JSONSCHEMA_H
+#define HTCW_JSONSCHEMA_H
+#include <math.h>
+#include "Json.h"
+
+// A subset of JSON Schema compiled into fixed tables of N schema nodes, P
+// properties and E enum values. Supports type, properties, required,
+// additionalProperties (false), items (a single schema), enum, const,
+// minimum, maximum, exclusiveMinimum, exclusiveMaximum (either draft),
+// minLength, maxLength, minItems and maxItems. Other keywords are ignored.
+// Property names and enum values are kept as 32-bit hashes, not strings
+template<size_t N = 16, size_t P = 32, size_t E = 16> class JsonSchema {
+  public:
+    // value types, as a mask
+    static const uint8_t TypeNull = 1;
+    static const uint8_t TypeBoolean = 2;
+    static const uint8_t TypeInteger = 4;
+    static const uint8_t TypeNumber = 8;
+    static const uint8_t TypeString = 16;
+    static const uint8_t TypeArray = 32;
+    static const uint8_t TypeObject = 64;
+    static const uint8_t TypeAny = 127;
+    // node flags. ExclusiveMinimum and ExclusiveMaximum are the draft 4
+    // booleans that make minimum and maximum exclusive. the later drafts'
+    // numeric exclusiveMinimum and exclusiveMaximum are kept apart from
+    // those, so both can apply whatever order they're written in
+    static const uint8_t HasMinimum = 1;
+    static const uint8_t HasMaximum = 2;
+    static const uint8_t ExclusiveMinimum = 4;
+    static const uint8_t ExclusiveMaximum = 8;
+    static const uint8_t NoAdditionalProperties = 16;
+    static const uint8_t HasExclusiveMinimum = 32;
+    static const uint8_t HasExclusiveMaximum = 64;
+    // a node or property index that accepts anything
+    static const uint16_t None = 0xFFFF;
+    // compile errors
+    static const uint8_t NoError = 0;
+    static const uint8_t BadSchema = 1;
+    static const uint8_t TooBig = 2;
+
+    struct Node {
+      uint8_t types;
+      uint8_t flags;
+      uint8_t propertyCount;
+      uint8_t enumCount;
+      uint16_t firstProperty;
+      uint16_t firstEnum;
+      uint16_t items;
+      uint16_t minLength;
+      uint16_t maxLength;
+      uint16_t minItems;
+      uint16_t maxItems;
+      // bitset over the property ordinals
+      uint32_t required;
+      double minimum;
+      double maximum;
+      double exclusiveMinimum;
+      double exclusiveMaximum;
+    };
+    struct Property {
+      uint32_t hash;
+      uint16_t node;
+      uint16_t next;
+      uint8_t ordinal;
+    };
+
+  private:
+    Node _nodes[N];
+    Property _properties[P];
+    uint32_t _enums[E];
+    uint16_t _nodeCount;
+    uint16_t _propertyCount;
+    uint16_t _enumCount;
+    uint8_t _error;
+
+    bool fail(uint8_t error) {
+      _error = error;
+      return false;
+    }
+    uint16_t addNode(uint8_t types) {
+      if (N <= _nodeCount) {
+        fail(TooBig);
+        return None;
+      }
+      Node& node = _nodes[_nodeCount];
+      memset(&node, 0, sizeof(Node));
+      node.types = types;
+      node.firstProperty = None;
+      node.items = None;
+      node.maxLength = 0xFFFF;
+      node.maxItems = 0xFFFF;
+      return _nodeCount++;
+    }
+    uint16_t addProperty(uint16_t node, uint32_t hash) {
+      uint16_t* link = &_nodes[node].firstProperty;
+      while (None != *link) {
+        if (_properties[*link].hash == hash)
+          return *link;
+        link = &_properties[*link].next;
+      }
+      if (P <= _propertyCount || 32 <= _nodes[node].propertyCount) {
+        fail(TooBig);
+        return None;
+      }
+      Property& property = _properties[_propertyCount];
+      property.hash = hash;
+      property.node = None;
+      property.next = None;
+      property.ordinal = _nodes[node].propertyCount++;
+      *link = _propertyCount;
+      return _propertyCount++;
+    }
+    static uint8_t typeFromName(const char* name) {
+      if (!strcmp(name, "null"))
+        return TypeNull;
+      if (!strcmp(name, "boolean"))
+        return TypeBoolean;
+      if (!strcmp(name, "integer"))
+        return TypeInteger;
+      if (!strcmp(name, "number"))
+        return TypeNumber | TypeInteger;
+      if (!strcmp(name, "string"))
+        return TypeString;
+      if (!strcmp(name, "array"))
+        return TypeArray;
+      if (!strcmp(name, "object"))
+        return TypeObject;
+      return 0;
+    }
+    // reads a schema or a boolean schema into a node. the reader is on it
+    template<size_t S> uint16_t compileValue(JsonReader<S>& reader) {
+      if (JsonReader<S>::Object == reader.nodeType())
+        return compileNode(reader);
+      if (JsonReader<S>::Value == reader.nodeType() && JsonReader<S>::Boolean == reader.valueType())
+        return reader.booleanValue() ? None : addNode(0);
+      fail(BadSchema);
+      return None;
+    }
+    template<size_t S> bool readUnsigned(JsonReader<S>& reader, uint16_t& result) {
+      if (!reader.read() || JsonReader<S>::Value != reader.nodeType() || JsonReader<S>::Number != reader.valueType())
+        return fail(BadSchema);
+      double value = reader.numericValue();
+      result = (0 > value) ? 0 : (65535 < value ? 65535 : (uint16_t)value);
+      return true;
+    }
+    template<size_t S> bool readBound(JsonReader<S>& reader, uint16_t index, bool maximum, bool exclusive) {
+      Node& node = _nodes[index];
+      if (!reader.read() || JsonReader<S>::Value != reader.nodeType())
+        return fail(BadSchema);
+      // draft 4 exclusiveMinimum/exclusiveMaximum are booleans
+      if (JsonReader<S>::Boolean == reader.valueType()) {
+        if (reader.booleanValue())
+          node.flags |= maximum ? ExclusiveMaximum : ExclusiveMinimum;
+        return true;
+      }
+      if (JsonReader<S>::Number != reader.valueType())
+        return fail(BadSchema);
+      if (maximum) {
+        if (exclusive) {
+          node.exclusiveMaximum = reader.numericValue();
+          node.flags |= HasExclusiveMaximum;
+        } else {
+          node.maximum = reader.numericValue();
+          node.flags |= HasMaximum;
+        }
+      } else {
+        if (exclusive) {
+          node.exclusiveMinimum = reader.numericValue();
+          node.flags |= HasExclusiveMinimum;
+        } else {
+          node.minimum = reader.numericValue();
+          node.flags |= HasMinimum;
+        }
+      }
+      return true;
+    }
+    template<size_t S> bool addEnum(JsonReader<S>& reader, uint16_t index) {
+      if (JsonReader<S>::Value != reader.nodeType())
+        return fail(BadSchema);
+      if (E <= _enumCount)
+        return fail(TooBig);
+      Node& node = _nodes[index];
+      if (!node.enumCount)
+        node.firstEnum = _enumCount;
+      else if (node.firstEnum + node.enumCount != _enumCount)
+        return fail(BadSchema); // enum and const on the same node
+      _enums[_enumCount++] = hashValue(reader);
+      ++node.enumCount;
+      return true;
+    }
+    template<size_t S> uint16_t compileNode(JsonReader<S>& reader) {
+      uint16_t index = addNode(TypeAny);
+      if (None == index)
+        return None;
+      uint8_t types = 0;
+      while (NoError == _error && reader.read() && JsonReader<S>::Field == reader.nodeType()) {
+        reader.undecorate();
+        const char* keyword = reader.value();
+        if (!strcmp(keyword, "type")) {
+          if (!reader.read())
+            fail(BadSchema);
+          else if (JsonReader<S>::Array == reader.nodeType()) {
+            while (reader.read() && JsonReader<S>::Value == reader.nodeType()) {
+              reader.undecorate();
+              types |= typeFromName(reader.value());
+            }
+          } else {
+            reader.undecorate();
+            types |= typeFromName(reader.value());
+          }
+        } else if (!strcmp(keyword, "properties")) {
+          if (!reader.read() || JsonReader<S>::Object != reader.nodeType()) {
+            fail(BadSchema);
+            break;
+          }
+          while (NoError == _error && reader.read() && JsonReader<S>::Field == reader.nodeType()) {
+            uint16_t property = addProperty(index, hashString(reader.value()));
+            if (None == property || !reader.read())
+              break;
+            uint16_t child = compileValue(reader);
+            _properties[property].node = child;
+          }
+        } else if (!strcmp(keyword, "required")) {
+          if (!reader.read() || JsonReader<S>::Array != reader.nodeType()) {
+            fail(BadSchema);
+            break;
+          }
+          while (NoError == _error && reader.read() && JsonReader<S>::Value == reader.nodeType()) {
+            uint16_t property = addProperty(index, hashString(reader.value()));
+            if (None != property)
+              _nodes[index].required |= 1UL << _properties[property].ordinal;
+          }
+        } else if (!strcmp(keyword, "enum")) {
+          if (!reader.read() || JsonReader<S>::Array != reader.nodeType()) {
+            fail(BadSchema);
+            break;
+          }
+          while (NoError == _error && reader.read() && JsonReader<S>::EndArray != reader.nodeType())
+            addEnum(reader, index);
+        } else if (!strcmp(keyword, "const")) {
+          if (reader.read())
+            addEnum(reader, index);
+        } else if (!strcmp(keyword, "items")) {
+          if (!reader.read())
+            fail(BadSchema);
+          else if (JsonReader<S>::Array == reader.nodeType())
+            reader.skipSubtree(); // tuples aren't supported
+          else {
+            uint16_t child = compileValue(reader);
+            _nodes[index].items = child;
+          }
+        } else if (!strcmp(keyword, "additionalProperties")) {
+          if (!reader.read())
+            fail(BadSchema);
+          else if (JsonReader<S>::Value == reader.nodeType() && JsonReader<S>::Boolean == reader.valueType()) {
+            if (!reader.booleanValue())
+              _nodes[index].flags |= NoAdditionalProperties;
+          } else
+            reader.skipSubtree();
+        } else if (!strcmp(keyword, "minimum"))
+          readBound(reader, index, false, false);
+        else if (!strcmp(keyword, "maximum"))
+          readBound(reader, index, true, false);
+        else if (!strcmp(keyword, "exclusiveMinimum"))
+          readBound(reader, index, false, true);
+        else if (!strcmp(keyword, "exclusiveMaximum"))
+          readBound(reader, index, true, true);
+        else if (!strcmp(keyword, "minLength"))
+          readUnsigned(reader, _nodes[index].minLength);
+        else if (!strcmp(keyword, "maxLength"))
+          readUnsigned(reader, _nodes[index].maxLength);
+        else if (!strcmp(keyword, "minItems"))
+          readUnsigned(reader, _nodes[index].minItems);
+        else if (!strcmp(keyword, "maxItems"))
+          readUnsigned(reader, _nodes[index].maxItems);
+        else
+          reader.skipSubtree();
+      }
+      if (JsonReader<S>::Error == reader.nodeType())
+        fail(BadSchema);
+      if (types)
+        _nodes[index].types = types;
+      return index;
+    }
+
+  public:
+    JsonSchema() {
+      clear();
+    }
+    void clear() {
+      _nodeCount = 0;
+      _propertyCount = 0;
+      _enumCount = 0;
+      _error = NoError;
+    }
+    uint8_t error() const {
+      return _error;
+    }
+    // compiles the schema document from reader, which must have just been
+    // begun. the reader's capture size limits the longest name or value
+    template<size_t S> bool compile(JsonReader<S>& reader) {
+      clear();
+      if (!reader.read())
+        return fail(BadSchema);
+      if (None == compileValue(reader)) {
+        // true, or {}, accepts anything
+        if (NoError == _error && None == addNode(TypeAny))
+          return false;
+      }
+      return NoError == _error;
+    }
+    const Node& node(uint16_t index) const {
+      return _nodes[index];
+    }
+    // finds the property of node with the hash, or returns None
+    uint16_t findProperty(uint16_t node, uint32_t hash) const {
+      for (uint16_t i = _nodes[node].firstProperty; None != i; i = _properties[i].next)
+        if (_properties[i].hash == hash)
+          return i;
+      return None;
+    }
+    const Property& property(uint16_t index) const {
+      return _properties[index];
+    }
+    bool hasEnum(uint16_t node, uint32_t hash) const {
+      const Node& n = _nodes[node];
+      for (uint16_t i = 0; i < n.enumCount; ++i)
+        if (_enums[n.firstEnum + i] == hash)
+          return true;
+      return false;
+    }
+    // property names and enum strings are matched by these. length gets
+    // the length in characters
+    static uint32_t hashString(const char* raw, uint16_t* length = NULL) {
+      return JsonReader<1>::hashString<uint32_t>(raw, length);
+    }
+    // hashes the scalar value the reader is on, for enum matching. numbers
+    // hash by value, so 1 and 1.0 are the same
+    template<size_t S> static uint32_t hashValue(JsonReader<S>& reader) {
+      switch (reader.valueType()) {
+        case JsonReader<S>::String:
+          return hashString(reader.value()) ^ 0x73UL;
+        case JsonReader<S>::Number:
+          return JsonReader<1>::hashNumber<uint32_t>(reader.value()) ^ 0x6EUL;
+        case JsonReader<S>::Boolean:
+          return reader.booleanValue() ? 0x74UL : 0x66UL;
+        default:
+          return 0x7AUL;
+      }
+    }
+};
+
+// Validates a document against a compiled JsonSchema alongside read(), in
+// one forward pass. Call read() here instead of on the reader. It stops
+// at the first node that breaks the schema, so the rest of a bad document
+// is never read. Memory is a frame per open array or object, up to D deep
+template<typename TSchema, size_t D = 8> class JsonValidator {
+  public:
+    static const uint8_t NoViolation = 0;
+    static const uint8_t WrongType = 1;
+    static const uint8_t NotInEnum = 2;
+    static const uint8_t OutOfRange = 3;
+    static const uint8_t WrongLength = 4;
+    static const uint8_t TooManyItems = 5;
+    static const uint8_t TooFewItems = 6;
+    static const uint8_t MissingRequired = 7;
+    static const uint8_t UnexpectedProperty = 8;
+    static const uint8_t TooDeep = 9;
+
+  private:
+    struct Frame {
+      uint16_t node;
+      bool object;
+      uint16_t count;
+      uint32_t seen;
+    };
+    const TSchema* _schema;
+    Frame _frames[D];
+    int16_t _top;
+    uint16_t _pending;
+    uint8_t _violation;
+
+    bool violate(uint8_t violation) {
+      _violation = violation;
+      return false;
+    }
+    template<size_t S> bool checkValue(uint16_t index, JsonReader<S>& reader) {
+      int8_t nodeType = reader.nodeType();
+      if (TSchema::None == index)
+        return true;
+      const typename TSchema::Node& node = _schema->node(index);
+      uint8_t type;
+      double number = 0;
+      if (JsonReader<S>::Array == nodeType)
+        type = TSchema::TypeArray;
+      else if (JsonReader<S>::Object == nodeType)
+        type = TSchema::TypeObject;
+      else {
+        switch (reader.valueType()) {
+          case JsonReader<S>::String:
+            type = TSchema::TypeString;
+            break;
+          case JsonReader<S>::Number:
+            number = reader.numericValue();
+            type = (floor(number) == number) ? (TSchema::TypeNumber | TSchema::TypeInteger) : TSchema::TypeNumber;
+            break;
+          case JsonReader<S>::Boolean:
+            type = TSchema::TypeBoolean;
+            break;
+          default:
+            type = TSchema::TypeNull;
+            break;
+        }
+      }
+      if (!(node.types & type))
+        return violate(WrongType);
+      if (node.enumCount && (JsonReader<S>::Value != nodeType || !_schema->hasEnum(index, TSchema::hashValue(reader))))
+        return violate(NotInEnum);
+      if (TSchema::TypeNumber & type) {
+        if ((TSchema::HasMinimum & node.flags) && (number < node.minimum || ((TSchema::ExclusiveMinimum & node.flags) && number == node.minimum)))
+          return violate(OutOfRange);
+        if ((TSchema::HasMaximum & node.flags) && (number > node.maximum || ((TSchema::ExclusiveMaximum & node.flags) && number == node.maximum)))
+          return violate(OutOfRange);
+        if ((TSchema::HasExclusiveMinimum & node.flags) && number <= node.exclusiveMinimum)
+          return violate(OutOfRange);
+        if ((TSchema::HasExclusiveMaximum & node.flags) && number >= node.exclusiveMaximum)
+          return violate(OutOfRange);
+      } else if (TSchema::TypeString == type && (node.minLength || 0xFFFF != node.maxLength)) {
+        uint16_t length;
+        TSchema::hashString(reader.value(), &length);
+        if (length < node.minLength || length > node.maxLength)
+          return violate(WrongLength);
+      }
+      return true;
+    }
+
+  public:
+    JsonValidator() : _schema(NULL), _top(-1), _pending(TSchema::None), _violation(NoViolation) {
+    }
+    bool begin(const TSchema& schema) {
+      _schema = &schema;
+      _top = -1;
+      _pending = 0;
+      _violation = NoViolation;
+      return true;
+    }
+    uint8_t violation() const {
+      return _violation;
+    }
+    // reads the next node and checks it. returns false at the end of the
+    // document, on a reader error, or on a violation
+    template<size_t S> bool read(JsonReader<S>& reader) {
+      if (NoViolation != _violation || !reader.read())
+        return false;
+      int8_t nodeType = reader.nodeType();
+      uint16_t index;
+      switch (nodeType) {
+        case JsonReader<S>::Error:
+          return false;
+        case JsonReader<S>::Field:
+          if (0 > _top || TSchema::None == _frames[_top].node) {
+            _pending = TSchema::None;
+            return true;
+          }
+          index = _schema->findProperty(_frames[_top].node, TSchema::hashString(reader.value()));
+          if (TSchema::None == index) {
+            if (TSchema::NoAdditionalProperties & _schema->node(_frames[_top].node).flags)
+              return violate(UnexpectedProperty);
+            _pending = TSchema::None;
+            return true;
+          }
+          _frames[_top].seen |= 1UL << _schema->property(index).ordinal;
+          _pending = _schema->property(index).node;
+          return true;
+        case JsonReader<S>::EndArray:
+        case JsonReader<S>::EndObject:
+          if (0 > _top)
+            return true;
+          index = _frames[_top].node;
+          if (TSchema::None != index) {
+            const typename TSchema::Node& node = _schema->node(index);
+            if (JsonReader<S>::EndArray == nodeType && _frames[_top].count < node.minItems)
+              return violate(TooFewItems);
+            if (JsonReader<S>::EndObject == nodeType && (node.required & ~_frames[_top].seen))
+              return violate(MissingRequired);
+          }
+          --_top;
+          return true;
+        default:
+          break;
+      }
+      // a value, array or object. work out which schema it answers to
+      if (0 > _top)
+        index = _pending;
+      else if (_frames[_top].object)
+        index = _pending;
+      else {
+        index = _frames[_top].node;
+        if (TSchema::None != index) {
+          if (++_frames[_top].count > _schema->node(index).maxItems)
+            return violate(TooManyItems);
+          index = _schema->node(index).items;
+        }
+      }
+      _pending = TSchema::None;
+      if (!checkValue(index, reader))
+        return false;
+      if (JsonReader<S>::Array == nodeType || JsonReader<S>::Object == nodeType) {
+        if (D <= (size_t)(_top + 1))
+          return violate(TooDeep);
+        Frame& frame = _frames[++_top];
+        frame.node = index;
+        frame.object = JsonReader<S>::Object == nodeType;
+        frame.count = 0;
+        frame.seen = 0;
+      }
+      return true;
+    }
+};
+#endif
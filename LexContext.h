@@ -46,17 +46,43 @@ template<const size_t S> class LexContext {
       setLocation(1, 0, 0);
       return true;
     }
+    // as begin() but O(1). the old capture contents are left in place
+    // rather than cleared, which nothing depends on
+    bool reset(Stream& stream) {
+      _capture[0] = 0;
+      _captureCount = 0;
+      _current = BeforeInput;
+      _pstream = &stream;
+      setLocation(1, 0, 0);
+      return true;
+    }
     void setLocation(uint32_t line, uint32_t column, uint64_t position) {
       _line = line;
       _column = column;
       _position = position;
     }
+    // moves the context to a location previously read from a seekable
+    // stream. position is the position() at that point, so the stream is
+    // sought to the character following current
+    template<typename TStream> bool seek(TStream& stream, int16_t current, uint32_t line, uint32_t column, uint64_t position) {
+      // reading the end of input counts as a character, but the stream
+      // ends one before it
+      if (!stream.seek((uint32_t)((EndOfInput == current && position) ? position - 1 : position)))
+        return false;
+      _pstream = &stream;
+      _current = current;
+      _captureCount = 0;
+      _capture[0] = 0;
+      setLocation(line, column, position);
+      return true;
+    }
 
 
     bool ensureStarted() {
       if (!_pstream) return false;
       if (BeforeInput == _current)
         advance();
+      return true;
     }
 
     int16_t advance() {
@@ -89,13 +115,23 @@ template<const size_t S> class LexContext {
       return _current;
     }
 
+    // the character after current, without advancing to it
+    int16_t peek() {
+      if (!_pstream) return Closed;
+      if (EndOfInput == _current)
+        return EndOfInput;
+      int d = _pstream->peek();
+      return (-1 == d) ? EndOfInput : (int16_t)d;
+    }
+
     size_t captureCount() const {
       return _captureCount;
     }
-    void setCaptureCount(size_t size) {
+    bool setCaptureCount(size_t size) {
 			if(size>S-1) return false;
 			_capture[size]=0;
 			_captureCount = size;
+			return true;
     }
     size_t captureMax() const {
       return S;
@@ -0,0 +1,222 @@
+#ifndef HTCW_READAHEADSTREAM_H
+#define HTCW_READAHEADSTREAM_H
+// host only. needs threads and a POSIX file API
+#if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// A Stream over a file descriptor that is read on a background thread.
+// The producer fills a ring of N buffers of B bytes each while the reader
+// consumes the previous one, so I/O and parsing overlap. The handoff is a
+// lock free single producer/single consumer ring, so only one thread may
+// read from the stream. end() wakes the producer through a self pipe, so
+// it doesn't wait on a pipe or socket whose writer has gone quiet
+template<size_t B = 65536, size_t N = 4> class ReadAheadStream : public Stream {
+    struct Buffer {
+      size_t length;
+      uint8_t data[B];
+    };
+    Buffer* _buffers;
+    // buffers filled and buffers released. both only ever increase
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+    std::atomic<bool> _done;
+    std::atomic<bool> _stop;
+    std::thread _thread;
+    int _fd;
+    // end() writes to _wake[1] to break the producer out of poll()
+    int _wake[2];
+    bool _owned;
+    int _error;
+    size_t _ahead;
+    uint8_t _hints;
+    bool _holding;
+    const uint8_t* _cursor;
+    size_t _remaining;
+
+    static void pause(uint32_t& spins) {
+      // spin briefly before backing off to the scheduler
+      if (64 > ++spins)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    void produce() {
+      uint64_t offset = 0;
+      uint32_t spins = 0;
+      while (!_stop.load(std::memory_order_relaxed)) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        // back pressure
+        if (head - _tail.load(std::memory_order_acquire) >= _ahead) {
+          pause(spins);
+          continue;
+        }
+        spins = 0;
+        Buffer& buffer = _buffers[head % N];
+#ifdef POSIX_FADV_WILLNEED
+        if (WillNeed & _hints)
+          posix_fadvise(_fd, (off_t)(offset + B), (off_t)(B * _ahead), POSIX_FADV_WILLNEED);
+#endif
+        struct pollfd fds[2];
+        fds[0].fd = _fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = _wake[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if (0 > ::poll(fds, 2, -1)) {
+          if (EINTR == errno)
+            continue;
+          _error = errno;
+          break;
+        }
+        if (fds[1].revents)
+          break;
+        ssize_t result = ::read(_fd, buffer.data, B);
+        if (0 > result && EINTR == errno)
+          continue;
+        if (0 >= result) {
+          _error = (0 > result) ? errno : 0;
+          break;
+        }
+        offset += (uint64_t)result;
+        buffer.length = (size_t)result;
+        _head.store(head + 1, std::memory_order_release);
+      }
+      _done.store(true, std::memory_order_release);
+    }
+    bool fill() {
+      if (_remaining)
+        return true;
+      if (!_buffers)
+        return false;
+      if (_holding) {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        _holding = false;
+      }
+      uint32_t spins = 0;
+      for (;;) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) != tail) {
+          Buffer& buffer = _buffers[tail % N];
+          _cursor = buffer.data;
+          _remaining = buffer.length;
+          _holding = true;
+          return true;
+        }
+        // the producer may have published a buffer right before finishing
+        if (_done.load(std::memory_order_acquire) && _head.load(std::memory_order_acquire) == tail)
+          return false;
+        pause(spins);
+      }
+    }
+
+  public:
+    // hints for the kernel's own read ahead. ignored where unsupported, and
+    // harmless on pipes
+    static const uint8_t Sequential = 1;
+    static const uint8_t WillNeed = 2;
+
+    ReadAheadStream() : _buffers(NULL), _head(0), _tail(0), _done(true), _stop(false), _fd(-1), _owned(false), _error(0), _ahead(N), _hints(0), _holding(false), _cursor(NULL), _remaining(0) {
+      _wake[0] = _wake[1] = -1;
+    }
+    ~ReadAheadStream() {
+      end();
+    }
+    // starts reading fd on the background thread. ahead is the most
+    // buffers the producer may fill before the reader releases them, from
+    // 1 to N
+    bool begin(int fd, size_t ahead = N, uint8_t hints = Sequential, bool owned = false) {
+      end();
+      if (0 > fd)
+        return false;
+      if (0 != ::pipe(_wake)) {
+        _wake[0] = _wake[1] = -1;
+        if (owned)
+          ::close(fd);
+        return false;
+      }
+      if (!_buffers)
+        _buffers = new Buffer[N];
+      _fd = fd;
+      _owned = owned;
+      _ahead = (ahead && ahead <= N) ? ahead : N;
+      _hints = hints;
+      _error = 0;
+      _head.store(0);
+      _tail.store(0);
+      _done.store(false);
+      _stop.store(false);
+      _holding = false;
+      _cursor = NULL;
+      _remaining = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+      if (Sequential & hints)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+      _thread = std::thread(&ReadAheadStream::produce, this);
+      return true;
+    }
+    bool begin(const char* path, size_t ahead = N, uint8_t hints = Sequential) {
+      return begin(::open(path, O_RDONLY), ahead, hints, true);
+    }
+    // stops the producer and releases the descriptor if we opened it
+    void end() {
+      _stop.store(true);
+      if (_thread.joinable()) {
+        ssize_t written;
+        do
+          written = ::write(_wake[1], "", 1);
+        while (0 > written && EINTR == errno);
+        _thread.join();
+      }
+      if (0 <= _wake[0]) {
+        ::close(_wake[0]);
+        ::close(_wake[1]);
+        _wake[0] = _wake[1] = -1;
+      }
+      if (_owned && 0 <= _fd)
+        ::close(_fd);
+      _fd = -1;
+      _owned = false;
+      _remaining = 0;
+      _holding = false;
+      delete[] _buffers;
+      _buffers = NULL;
+    }
+    // the errno from the last failed read, if any
+    int error() const {
+      return _error;
+    }
+    virtual int available() {
+      if (_remaining)
+        return (int)_remaining;
+      if (!_buffers)
+        return 0;
+      size_t tail = _tail.load(std::memory_order_relaxed) + (_holding ? 1 : 0);
+      if (_head.load(std::memory_order_acquire) != tail)
+        return (int)_buffers[tail % N].length;
+      return 0;
+    }
+    virtual int read() {
+      if (!fill())
+        return -1;
+      --_remaining;
+      return *(_cursor++);
+    }
+    virtual int peek() {
+      if (!fill())
+        return -1;
+      return *_cursor;
+    }
+    virtual size_t write(uint8_t) {
+      return 0;
+    }
+};
+#endif
+#endif
@@ -0,0 +1,111 @@
+// Concurrent parses per core with JsonCoroutine.h. One thread keeps K
+// parses in flight, feeding each a small chunk in turn, as an event loop
+// would with K slow connections. Each parse consumes its document through
+// JsonAsyncReader::events(). Reported against plain read() over memory.
+// The bytes per parse don't count the two coroutine frames on the heap
+//
+//   g++ -O2 -std=c++20 -I. -Ibench bench/CoroutineBench.cpp -o coroutine_bench
+#include "HostArduino.h"
+#include "JsonCoroutine.h"
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const size_t Chunk = 32;
+typedef JsonAsyncSource<512> Source;
+typedef JsonAsyncReader<64, 512> Reader;
+
+struct Parse {
+  Source source;
+  Reader reader;
+  size_t position;
+  size_t nodes;
+};
+
+static JsonTask consume(Reader& reader, size_t& nodes) {
+  JsonEventGenerator events = reader.events();
+  while (co_await events.next())
+    ++nodes;
+}
+static std::string makeDocument() {
+  std::string result = "{\"device\": \"gw-01\", \"seq\": 1234, \"readings\": [";
+  for (int i = 0; i < 16; ++i) {
+    if (i)
+      result += ", ";
+    result += "{\"ch\": " + std::to_string(i) + ", \"v\": " + std::to_string(i * 0.37) + ", \"ok\": true}";
+  }
+  result += "], \"note\": \"end of batch\"}";
+  return result;
+}
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+  std::string document = makeDocument();
+  size_t expected = 0;
+  {
+    // the synchronous baseline: one parse at a time, never waiting
+    const size_t runs = 20000;
+    JsonReader<64> reader;
+    MemoryStream stream;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; ++i) {
+      stream.begin(document.data(), document.size());
+      reader.begin(stream);
+      expected = 0;
+      while (reader.read())
+        ++expected;
+    }
+    double elapsed = seconds(start);
+    printf("read() loop, 1 at a time  %10.0f docs/s\n", runs / elapsed);
+  }
+  const size_t counts[] = {1, 100, 1000, 10000};
+  for (size_t k : counts) {
+    size_t rounds = (20000 + k - 1) / k;
+    size_t done = 0;
+    size_t bad = 0;
+    double elapsed = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+      std::vector<std::unique_ptr<Parse>> parses;
+      std::vector<JsonTask> tasks;
+      parses.reserve(k);
+      tasks.reserve(k);
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < k; ++i) {
+        parses.emplace_back(new Parse());
+        Parse& parse = *parses.back();
+        parse.position = 0;
+        parse.nodes = 0;
+        parse.reader.begin(parse.source);
+        tasks.push_back(consume(parse.reader, parse.nodes));
+      }
+      // round robin, a chunk per parse per pass
+      bool more = true;
+      while (more) {
+        more = false;
+        for (size_t i = 0; i < k; ++i) {
+          Parse& parse = *parses[i];
+          if (parse.position < document.size()) {
+            size_t length = document.size() - parse.position;
+            if (length > Chunk)
+              length = Chunk;
+            parse.position += parse.source.push((const uint8_t*)document.data() + parse.position, length);
+            more = true;
+          } else if (!parse.source.closed())
+            parse.source.close();
+        }
+      }
+      elapsed += seconds(start);
+      for (size_t i = 0; i < k; ++i) {
+        if (!tasks[i].done() || expected != parses[i]->nodes)
+          ++bad;
+        ++done;
+      }
+    }
+    printf("%5zu in flight on 1 core  %10.0f docs/s  %zu bytes per parse%s\n", k, done / elapsed, sizeof(Parse), bad ? "  MISMATCH" : "");
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef HTCW_HOSTARDUINO_H
+#define HTCW_HOSTARDUINO_H
+// The few Arduino core pieces the headers use, so the benchmarks in this
+// folder build on a PC. Not for use on a board
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#define PROGMEM
+#define strncpy_P strncpy
+
+class Print {
+  public:
+    virtual ~Print() {
+    }
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+      size_t result = 0;
+      while (size--)
+        result += write(*(buffer++));
+      return result;
+    }
+};
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+// a Stream over a block of memory
+class MemoryStream : public Stream {
+    const uint8_t* _data;
+    size_t _length;
+    size_t _position;
+  public:
+    MemoryStream(const void* data = NULL, size_t length = 0) {
+      begin(data, length);
+    }
+    void begin(const void* data, size_t length) {
+      _data = (const uint8_t*)data;
+      _length = length;
+      _position = 0;
+    }
+    bool seek(uint64_t position) {
+      if (position > _length)
+        return false;
+      _position = (size_t)position;
+      return true;
+    }
+    virtual int available() {
+      return (int)(_length - _position);
+    }
+    virtual int read() {
+      return (_position < _length) ? _data[_position++] : -1;
+    }
+    virtual int peek() {
+      return (_position < _length) ? _data[_position] : -1;
+    }
+    virtual size_t write(uint8_t) {
+      return 0;
+    }
+};
+#endif
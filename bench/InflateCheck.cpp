@@ -0,0 +1,92 @@
+// Checks InflateStream against the fixtures in bench/fixtures: the same
+// JSON document as gzip, zlib and raw deflate, each of which must inflate
+// to sample.json byte for byte and read through a JsonReader cleanly. It
+// also checks that a truncated body, a gzip body with a bad CRC and a
+// window smaller than the data was compressed with are reported. The .gz
+// has a back reference of over 256 bytes. Run it from the repository root.
+//
+//   g++ -O2 -std=c++11 -I. -Ibench bench/InflateCheck.cpp -o inflate_check
+#include "HostArduino.h"
+#include "InflateStream.h"
+#include "Json.h"
+#include <stdio.h>
+#include <string>
+
+static int failures = 0;
+
+static bool load(const char* path, std::string& result) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    printf("can't open %s\n", path);
+    return false;
+  }
+  char buffer[1024];
+  size_t count;
+  result.clear();
+  while (0 < (count = fread(buffer, 1, sizeof(buffer), file)))
+    result.append(buffer, count);
+  fclose(file);
+  return true;
+}
+static void check(const char* name, bool passed) {
+  printf("%s %s\n", passed ? "pass" : "FAIL", name);
+  if (!passed)
+    ++failures;
+}
+// inflates all of data and returns the error, if any
+template<size_t W> static uint8_t inflate(const std::string& data, uint8_t format, std::string& result) {
+  MemoryStream source(data.data(), data.size());
+  InflateStream<W> stream;
+  stream.begin(source, format);
+  int ch;
+  result.clear();
+  while (-1 != (ch = stream.read()))
+    result += (char)ch;
+  return stream.error();
+}
+// reads the whole document through a JsonReader over the inflate stream
+static bool parses(const std::string& data) {
+  MemoryStream source(data.data(), data.size());
+  InflateStream<> stream;
+  stream.begin(source);
+  JsonReader<512> reader;
+  reader.begin(stream);
+  size_t nodes = 0;
+  while (reader.read())
+    ++nodes;
+  return JsonReader<512>::EndDocument == reader.nodeType() && InflateStream<>::NoError == stream.error() && 0 < nodes;
+}
+
+int main() {
+  static const char* const names[] = {"sample.json.gz", "sample.json.z", "sample.json.deflate"};
+  static const uint8_t formats[] = {InflateStream<>::Gzip, InflateStream<>::Zlib, InflateStream<>::Deflate};
+  std::string expected;
+  if (!load("bench/fixtures/sample.json", expected))
+    return 1;
+  std::string fixtures[3];
+  for (size_t i = 0; i < 3; ++i) {
+    std::string path = std::string("bench/fixtures/") + names[i];
+    if (!load(path.c_str(), fixtures[i]))
+      return 1;
+  }
+  std::string result;
+  for (size_t i = 0; i < 3; ++i) {
+    std::string name = names[i];
+    check((name + " inflates").c_str(), InflateStream<>::NoError == inflate<32768>(fixtures[i], formats[i], result) && result == expected);
+    check((name + " inflates with Auto").c_str(), InflateStream<>::NoError == inflate<32768>(fixtures[i], InflateStream<>::Auto, result) && result == expected);
+    check((name + " parses").c_str(), parses(fixtures[i]));
+    std::string truncated = fixtures[i].substr(0, fixtures[i].size() / 2);
+    check((name + " truncated").c_str(), InflateStream<>::UnexpectedEnd == inflate<32768>(truncated, formats[i], result));
+  }
+  // the gzip trailer is the CRC-32 then the length
+  std::string corrupt = fixtures[0];
+  corrupt[corrupt.size() - 8] ^= 0x01;
+  check("sample.json.gz bad CRC", InflateStream<>::BadChecksum == inflate<32768>(corrupt, InflateStream<>::Gzip, result));
+  // the zlib trailer is the Adler-32
+  corrupt = fixtures[1];
+  corrupt[corrupt.size() - 1] ^= 0x01;
+  check("sample.json.z bad Adler-32", InflateStream<>::BadChecksum == inflate<32768>(corrupt, InflateStream<>::Zlib, result));
+  check("sample.json.gz window too small", InflateStream<256>::WindowTooSmall == inflate<256>(fixtures[0], InflateStream<256>::Gzip, result));
+  printf("%d failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+// Messages per second for tiny documents: building a reader and calling
+// begin() per message, reusing a reader per thread with begin(), and
+// checking a reader out of a JsonReaderPool, which reset()s it. begin()
+// clears the whole S byte capture buffer and reset() doesn't, so the gap
+// grows with S. It is run for a few capture sizes to show where it starts
+// to matter.
+//
+//   g++ -O2 -std=c++11 -pthread -I. -Ibench bench/ReaderPoolBench.cpp -o pool_bench
+#include "HostArduino.h"
+#include "JsonReaderPool.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const size_t Messages = 1000000;
+static const char* const message = "{\"id\":4711,\"t\":21.5,\"ok\":true}";
+static std::atomic<size_t> checksum(0);
+
+template<size_t S> struct Bench {
+  static JsonReaderPool<S, 8>* pool;
+
+  // reads the message and returns its node count, so nothing is optimized
+  // out
+  static size_t consume(JsonReader<S>& reader) {
+    size_t result = 0;
+    while (reader.read())
+      ++result;
+    return result;
+  }
+  static void constructEach(size_t count) {
+    MemoryStream stream;
+    size_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      stream.begin(message, strlen(message));
+      std::unique_ptr<JsonReader<S>> reader(new JsonReader<S>());
+      reader->begin(stream);
+      sum += consume(*reader);
+    }
+    checksum += sum;
+  }
+  static void beginEach(size_t count) {
+    MemoryStream stream;
+    std::unique_ptr<JsonReader<S>> reader(new JsonReader<S>());
+    size_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      stream.begin(message, strlen(message));
+      reader->begin(stream);
+      sum += consume(*reader);
+    }
+    checksum += sum;
+  }
+  static void pooled(size_t count) {
+    MemoryStream stream;
+    size_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      stream.begin(message, strlen(message));
+      JsonReader<S>* reader = pool->checkout(stream);
+      if (!reader)
+        continue;
+      sum += consume(*reader);
+      pool->checkin(reader);
+    }
+    checksum += sum;
+  }
+  static void run(const char* name, void (*work)(size_t), size_t threads) {
+    std::vector<std::thread> workers;
+    checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < threads; ++i)
+      workers.push_back(std::thread(work, Messages / threads));
+    for (size_t i = 0; i < threads; ++i)
+      workers[i].join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("S=%-6zu %-28s %zu threads %12.0f msgs/s  (%zu nodes)\n", S, name, threads, (Messages / threads) * threads / elapsed, checksum.load());
+  }
+  static void runAll(size_t threads) {
+    pool = new JsonReaderPool<S, 8>();
+    run("new reader + begin()", constructEach, threads);
+    run("per thread reader + begin()", beginEach, threads);
+    run("pool checkout + reset()", pooled, threads);
+    JsonReaderPoolStats stats = pool->stats();
+    printf("         pool: %u checkouts, %u misses, peak %u\n", (unsigned)stats.checkouts, (unsigned)stats.misses, (unsigned)stats.peak);
+    delete pool;
+  }
+};
+template<size_t S> JsonReaderPool<S, 8>* Bench<S>::pool = NULL;
+
+int main() {
+  size_t cores = std::thread::hardware_concurrency();
+  if (!cores)
+    cores = 1;
+  if (8 < cores)
+    cores = 8;
+  const size_t threads[] = {1, cores};
+  for (size_t i = 0; i < ((1 < cores) ? 2 : 1); ++i) {
+    Bench<256>::runAll(threads[i]);
+    Bench<4096>::runAll(threads[i]);
+    Bench<32768>::runAll(threads[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+// JsonReader::parse() with a handler against the equivalent read() loop,
+// over a telemetry style document in memory. Both count the nodes, sum
+// the numbers and look at every string, so they do the same work.
+//
+//   g++ -O2 -std=c++11 -I. -Ibench bench/SaxBench.cpp -o sax_bench
+#include "HostArduino.h"
+#include "Json.h"
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+static const int Runs = 5;
+
+class Totals : public JsonHandler {
+  public:
+    size_t nodes;
+    size_t chars;
+    double sum;
+    Totals() : nodes(0), chars(0), sum(0) {
+    }
+    int8_t onStartObject() {
+      ++nodes;
+      return Continue;
+    }
+    int8_t onEndObject() {
+      ++nodes;
+      return Continue;
+    }
+    int8_t onStartArray() {
+      ++nodes;
+      return Continue;
+    }
+    int8_t onEndArray() {
+      ++nodes;
+      return Continue;
+    }
+    int8_t onKey(const char*, size_t length) {
+      ++nodes;
+      chars += length;
+      return Continue;
+    }
+    int8_t onString(const char*, size_t length) {
+      ++nodes;
+      chars += length;
+      return Continue;
+    }
+    int8_t onNumber(double value) {
+      ++nodes;
+      sum += value;
+      return Continue;
+    }
+    int8_t onNumber(int64_t value) {
+      ++nodes;
+      sum += (double)value;
+      return Continue;
+    }
+    int8_t onBoolean(bool) {
+      ++nodes;
+      return Continue;
+    }
+    int8_t onNull() {
+      ++nodes;
+      return Continue;
+    }
+};
+
+static std::string makeDocument() {
+  std::string result = "[";
+  char buffer[160];
+  for (int i = 0; i < 100000; ++i) {
+    snprintf(buffer, sizeof(buffer), "%s{\"id\": %d, \"name\": \"sensor-%d\", \"temp\": %.2f, \"samples\": [%d, %d, %d], \"ok\": %s, \"err\": null}", i ? ", " : "", i, i % 97, 20.0 + (i % 150) * 0.1, i % 7, i % 11, i % 13, (i % 3) ? "true" : "false");
+    result += buffer;
+  }
+  result += "]";
+  return result;
+}
+
+int main() {
+  std::string document = makeDocument();
+  double mb = document.size() / 1048576.0;
+  double bestRead = 1e9;
+  double bestParse = 1e9;
+  Totals read;
+  Totals parsed;
+  for (int run = 0; run < Runs; ++run) {
+    MemoryStream stream(document.data(), document.size());
+    JsonReader<64> reader;
+    reader.begin(stream);
+    read = Totals();
+    auto start = std::chrono::steady_clock::now();
+    while (reader.read()) {
+      ++read.nodes;
+      if (JsonReader<64>::Field == reader.nodeType()) {
+        reader.undecorate();
+        read.chars += strlen(reader.value());
+      } else if (JsonReader<64>::Value == reader.nodeType()) {
+        if (JsonReader<64>::Number == reader.valueType())
+          read.sum += reader.numericValue();
+        else if (JsonReader<64>::String == reader.valueType()) {
+          reader.undecorate();
+          read.chars += strlen(reader.value());
+        }
+      }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed < bestRead)
+      bestRead = elapsed;
+
+    stream.begin(document.data(), document.size());
+    reader.begin(stream);
+    parsed = Totals();
+    start = std::chrono::steady_clock::now();
+    reader.parse(parsed);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed < bestParse)
+      bestParse = elapsed;
+  }
+  printf("%.1f MB, best of %d\n", mb, Runs);
+  printf("read() loop   %8.1f ms %8.1f MB/s  nodes %zu chars %zu sum %.1f\n", bestRead * 1000, mb / bestRead, read.nodes, read.chars, read.sum);
+  printf("parse()       %8.1f ms %8.1f MB/s  nodes %zu chars %zu sum %.1f\n", bestParse * 1000, mb / bestParse, parsed.nodes, parsed.chars, parsed.sum);
+  printf("parse() takes %.2fx the time of read()\n", bestParse / bestRead);
+  return 0;
+}